@@ -0,0 +1,8 @@
+#pragma once
+
+// ===============================
+// BENCHMARKS
+// ===============================
+// Build with -D LIGHTSHOW_BENCH to run these once from setup() and print
+// the results before normal operation starts.
+void runBenchmarks();
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ===============================
+// PACKED COLOR MATH
+// ===============================
+// Fades and blends on 0x00RRGGBB words, all three channels per integer
+// operation. Red and blue sit 16 bits apart and are processed together
+// under the mask 0xFF00FF, green separately under 0x00FF00; the 8 spare
+// bits above each channel catch products and carries. Scale factors run
+// 0..256, where 256 leaves the color unchanged.
+
+#define COLOR_RB 0x00FF00FFu
+#define COLOR_G 0x0000FF00u
+
+// Each channel times scale / 256
+inline uint32_t colorScale(uint32_t color, uint32_t scale) {
+  uint32_t rb = ((color & COLOR_RB) * scale) >> 8;
+  uint32_t g = ((color & COLOR_G) * scale) >> 8;
+  return (rb & COLOR_RB) | (g & COLOR_G);
+}
+
+// Channel-wise a + b, clamped at 255
+inline uint32_t colorAddSaturate(uint32_t a, uint32_t b) {
+  uint32_t rb = (a & COLOR_RB) + (b & COLOR_RB);
+  uint32_t g = (a & COLOR_G) + (b & COLOR_G);
+  // A carry bit above a channel becomes 0xFF over that channel
+  uint32_t rbCarry = rb & 0x01000100u;
+  uint32_t gCarry = g & 0x00010000u;
+  rb |= rbCarry - (rbCarry >> 8);
+  g |= gCarry - (gCarry >> 8);
+  return (rb & COLOR_RB) | (g & COLOR_G);
+}
+
+// a at t = 0 to b at t = 256
+inline uint32_t colorLerp(uint32_t a, uint32_t b, uint32_t t) {
+  uint32_t rb = ((a & COLOR_RB) * (256 - t) + (b & COLOR_RB) * t) >> 8;
+  uint32_t g = ((a & COLOR_G) * (256 - t) + (b & COLOR_G) * t) >> 8;
+  return (rb & COLOR_RB) | (g & COLOR_G);
+}
+
+// Dims by fade / 256, e.g. 32 takes an eighth off every frame
+inline uint32_t colorFadeToBlack(uint32_t color, uint32_t fade) {
+  return colorScale(color, 256 - fade);
+}
+
+inline void fadeToBlack(uint32_t* pixels, size_t count, uint32_t fade) {
+  for (size_t i = 0; i < count; i++) {
+    pixels[i] = colorFadeToBlack(pixels[i], fade);
+  }
+}
+
+inline void blendInto(uint32_t* pixels, const uint32_t* overlay, size_t count, uint32_t t) {
+  for (size_t i = 0; i < count; i++) {
+    pixels[i] = colorLerp(pixels[i], overlay[i], t);
+  }
+}
+
+// Classic color wheel: 0 = red, 85 = green, 170 = blue
+inline uint32_t colorWheel(uint8_t pos) {
+  if (pos < 85) {
+    return ((uint32_t)(255 - pos * 3) << 16) | ((uint32_t)(pos * 3) << 8);
+  }
+  if (pos < 170) {
+    pos -= 85;
+    return ((uint32_t)(255 - pos * 3) << 8) | (pos * 3);
+  }
+  pos -= 170;
+  return ((uint32_t)(pos * 3) << 16) | (255 - pos * 3);
+}
+
+// ===============================
+// 16-BIT PACKED COLOR MATH
+// ===============================
+// The same tricks on 0xRRRRGGGGBBBB words in a uint64_t, for frames that
+// keep the fraction the strip's 8 bits cannot show (see dither.h). Each
+// channel is 8.8 fixed point: 8-bit value v is v << 8, and 0xFF00 and up
+// is full on. Red and blue sit 32 bits apart under COLOR16_RB, green under
+// COLOR16_G, with 16 spare bits above each channel.
+typedef uint64_t Color16;
+
+#define COLOR16_RB 0x0000FFFF0000FFFFull
+#define COLOR16_G 0x00000000FFFF0000ull
+#define COLOR16_WHITE 0xFF00FF00FF00ull
+
+inline Color16 color16(uint32_t color) {
+  return ((uint64_t)(color & 0xFF0000) << 24) | ((uint64_t)(color & 0xFF00) << 16) | ((uint64_t)(color & 0xFF) << 8);
+}
+
+inline Color16 color16(uint16_t r, uint16_t g, uint16_t b) {
+  return ((uint64_t)r << 32) | ((uint64_t)g << 16) | b;
+}
+
+inline uint16_t color16Red(Color16 color) { return color >> 32; }
+inline uint16_t color16Green(Color16 color) { return color >> 16; }
+inline uint16_t color16Blue(Color16 color) { return color; }
+
+inline Color16 color16Scale(Color16 color, uint32_t scale) {
+  uint64_t rb = ((color & COLOR16_RB) * scale) >> 8;
+  uint64_t g = ((color & COLOR16_G) * scale) >> 8;
+  return (rb & COLOR16_RB) | (g & COLOR16_G);
+}
+
+inline Color16 color16AddSaturate(Color16 a, Color16 b) {
+  uint64_t rb = (a & COLOR16_RB) + (b & COLOR16_RB);
+  uint64_t g = (a & COLOR16_G) + (b & COLOR16_G);
+  uint64_t rbCarry = rb & 0x0001000000010000ull;
+  uint64_t gCarry = g & 0x0000000100000000ull;
+  rb |= rbCarry - (rbCarry >> 16);
+  g |= gCarry - (gCarry >> 16);
+  return (rb & COLOR16_RB) | (g & COLOR16_G);
+}
+
+inline Color16 color16Lerp(Color16 a, Color16 b, uint32_t t) {
+  uint64_t rb = ((a & COLOR16_RB) * (256 - t) + (b & COLOR16_RB) * t) >> 8;
+  uint64_t g = ((a & COLOR16_G) * (256 - t) + (b & COLOR16_G) * t) >> 8;
+  return (rb & COLOR16_RB) | (g & COLOR16_G);
+}
+
+inline void fadeToBlack16(Color16* pixels, size_t count, uint32_t fade) {
+  for (size_t i = 0; i < count; i++) {
+    pixels[i] = color16Scale(pixels[i], 256 - fade);
+  }
+}
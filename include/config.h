@@ -0,0 +1,108 @@
+#pragma once
+
+// ===============================
+// CONFIGURATION
+// ===============================
+
+// Microphone I2S pins
+#define I2S_WS 25    // LRCL / WS
+#define I2S_SD 33    // DOUT
+#define I2S_SCK 32   // BCLK / SCK
+
+// LED configuration
+#define LED_PIN     4
+#define LED_STRIP_LENGTH 60   // LEDs per strip
+#define BRIGHTNESS  100
+#define LED_RMT_MEM_BLOCKS 2  // 64 bit slots each; more slack for the refill interrupt
+#define LED_LATCH_US 300      // Low time that latches a frame (WS2812B needs > 280 us)
+#define LED_BYTE_US 10        // Wire time per color byte: 8 bits of 1.25 us (host model)
+#define LED_DITHER 1          // Temporal dithering from the 16-bit framebuffer (see dither.h)
+#define LED_DITHER_SETTLE 256 // Frames an unchanged pixel dithers before holding its nearest step
+
+// Parallel strips, one RMT channel each (up to 8), all clocked out at once.
+// Mirrored strips all show the same picture; spanned strips are chained
+// end to end into one long logical strip.
+#define LED_STRIPS 1
+#define LED_STRIP_PINS {LED_PIN}  // One per strip, e.g. {4, 16, 17, 18, 19, 21, 22, 23}
+#define LED_LAYOUT_MIRROR 0
+#define LED_LAYOUT_SPAN 1
+#define LED_LAYOUT LED_LAYOUT_MIRROR
+
+// Logical LEDs the renderers draw
+#if LED_LAYOUT == LED_LAYOUT_SPAN
+#define LED_COUNT (LED_STRIPS * LED_STRIP_LENGTH)
+#else
+#define LED_COUNT LED_STRIP_LENGTH
+#endif
+
+// 2D matrix instead of a strip (see matrix.h for the wiring flags). The VU
+// and spectrum then draw vertical bars. E.g. a serpentine 16x16 panel:
+// LED_STRIP_LENGTH 256, MATRIX_WIDTH 16, MATRIX_HEIGHT 16
+#define LED_MATRIX 0
+#define MATRIX_WIDTH 16
+#define MATRIX_HEIGHT 16
+#define MATRIX_WIRING (WIRING_SERPENTINE)
+#if LED_MATRIX && LED_COUNT != MATRIX_WIDTH * MATRIX_HEIGHT
+#error "LED_MATRIX needs LED_COUNT == MATRIX_WIDTH * MATRIX_HEIGHT"
+#endif
+
+// Audio processing
+#define I2S_PORT I2S_NUM_0
+#define BUFFER_LEN 64
+#define SAMPLE_RATE 44100
+#define DMA_BUF_COUNT 8
+#define I2S_EVENT_QUEUE_LEN 16  // Room for a full DMA ring of RX_DONE plus overflow events
+#define MAX_VOLUME_TARGET 3000  // Target maximum volume
+#define MIN_VOLUME 1500         // Smoothed volume below this is silence
+
+// Sample conditioning
+#define SAMPLE_SHIFT 14                 // SPH0645: 18-bit data in the top of a 32-bit word
+#define SPIKE_LIMIT 100000              // Ignore samples at or above this magnitude
+#define CALIBRATION_SPIKE_LIMIT 50000   // Stricter limit while measuring the noise floor
+
+// Spectrum analyzer (see spectrum.h for FFT size and band layout)
+#define SPECTRUM_ENABLED 1      // Run the FFT in the capture path
+#define WATERFALL_ROW_MS 40     // Matrix spectrogram scroll period
+
+// Effect shown at startup (see effects.cpp): "vu", "spectrum", "waterfall"
+// (matrix only), "pulse" or "ripple". 's' on the console steps through them.
+#define LED_EFFECT "vu"
+
+// VU volume-to-LED curve (see level_curve.h), 'm' on the console cycles it
+#define VU_CURVE CURVE_POWER
+#define SPECTRUM_RANGE_DB 36.0f // Dynamic range shown per band below its running peak
+#define SPECTRUM_PEAK_DECAY_DB 0.05f  // Per-frame fall of each band's reference peak
+
+// Goertzel bands: kick, bass, mid, presence, air
+#define GOERTZEL_ENABLED 1
+#define GOERTZEL_BANDS 5
+#define GOERTZEL_FREQUENCIES {60.0f, 150.0f, 1000.0f, 4000.0f, 10000.0f}
+#define GOERTZEL_WINDOW 1024    // Samples per band update (~23 ms)
+
+// Onset detection (see onset.h for the detector tuning)
+#define ONSET_ENABLED 1
+#define BEAT_DECAY 0.85f        // Per-frame fall of the level an onset kicks the VU to
+
+// Tempo tracking (see tempo.h); needs the FFT onset envelope
+#define TEMPO_ENABLED 1
+#if TEMPO_ENABLED && !(SPECTRUM_ENABLED && ONSET_ENABLED)
+#error "TEMPO_ENABLED needs SPECTRUM_ENABLED and ONSET_ENABLED"
+#endif
+
+// Logging (see log.h). Messages queue on a ring drained by a low-priority
+// task; 'v' on the console cycles the level at runtime.
+#define LOG_LEVEL LOG_LEVEL_DEBUG  // error, warn, info or debug (periodic statistics)
+#define LOG_RING_LEN 32            // Queued messages (must be a power of two)
+#define TRACE_EVENTS 2048          // Events kept with -D LIGHTSHOW_TRACE, 8 bytes each (power of two)
+
+// Per-frame volume telemetry (see telemetry.h): 1 sends binary frames for
+// tools/telemetry_decode, 0 the old text line for the Serial plotter
+#define TELEMETRY_BINARY 1
+
+// Latency probe (see latency.h): 'l' on the console measures mic-to-LED delay
+#define LATENCY_PROBE_COUNT 5         // Probes per series
+#define LATENCY_PROBE_MS 300          // Length of each noise burst
+#define LATENCY_PROBE_LEVEL 6000      // Burst RMS above the noise floor
+#define LATENCY_PROBE_LEDS (LED_COUNT / 10)  // Pixels that must light up to count as a reaction
+#define LATENCY_PROBE_TIMEOUT_MS 500  // Give up on a probe after this long
+#define LATENCY_PROBE_GAP_MS 1000     // Quiet time between probes
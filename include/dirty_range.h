@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// ===============================
+// DIRTY PIXEL RANGE
+// ===============================
+// Tracks the span of pixels written since the last show() so a sink can
+// compare just that span against the frame on the wire and skip the
+// transfer when nothing actually changed.
+class DirtyRange {
+public:
+  void mark(uint16_t index) {
+    if (index < first_) {
+      first_ = index;
+    }
+    if (index >= end_) {
+      end_ = index + 1;
+    }
+  }
+
+  // Grows the span to cover another one as well
+  void include(const DirtyRange& other) {
+    if (!other.empty()) {
+      mark(other.first_);
+      mark(other.end_ - 1);
+    }
+  }
+
+  bool empty() const { return end_ <= first_; }
+  uint16_t first() const { return first_; }
+  uint16_t end() const { return end_; }  // One past the last marked pixel
+
+  // True when the marked span differs between two frames of pixelBytes each
+  bool differs(const uint8_t* frame, const uint8_t* sent, size_t pixelBytes) const {
+    return !empty() && memcmp(frame + first_ * pixelBytes, sent + first_ * pixelBytes,
+                              (end_ - first_) * pixelBytes) != 0;
+  }
+
+  void reset() {
+    first_ = UINT16_MAX;
+    end_ = 0;
+  }
+
+private:
+  uint16_t first_ = UINT16_MAX;
+  uint16_t end_ = 0;
+};
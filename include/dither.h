@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ===============================
+// TEMPORAL DITHERING
+// ===============================
+// Frames are kept at 16 bits per channel and reduced to the strip's 8 bits
+// on output. Each channel carries the low byte it could not show into the
+// next frame, so over a few frames its average brightness matches the
+// 16-bit value instead of snapping to the nearest 8-bit step.
+
+// Converts `channels` 16-bit values to 8 bits, updating the per-channel
+// error carried between frames. Returns true when any channel is between
+// 8-bit steps, i.e. the next frame may differ even if nothing is redrawn.
+// A whole step keeps its output however much error it carries.
+bool ditherFrame(const uint16_t* in, uint8_t* out, uint8_t* error, size_t channels);
+
+// Plain rounding to 8 bits, for comparison and for sinks that do not dither.
+// Values from 0xFF00 up are full on in both.
+void truncateFrame(const uint16_t* in, uint8_t* out, size_t channels);
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "color.h"
+#include "config.h"
+#include "hal.h"
+#include "spectrum.h"
+
+// ===============================
+// EFFECT ENGINE
+// ===============================
+// Visualizations are Effects kept in a registry and selected at runtime.
+// Each frame the engine hands the current one the audio features and a
+// frame buffer, times it, and pushes only the pixels that changed to the
+// LED sink. An effect that keeps overrunning its budget (the frame
+// interval minus what output took) is dropped to a cheaper quality level;
+// one that still overruns at its cheapest level gets every other frame
+// skipped. Rendering runs on its own core, so the worst an effect can do
+// is fall behind on frames, never hold up capture.
+#define EFFECT_MAX 8
+#define EFFECT_OVERRUNS_TO_DOWNGRADE 3  // Consecutive overruns before dropping a level
+#define EFFECT_UPGRADE_FRAMES 400       // Frames well inside the budget before trying a better level
+#define EFFECT_UPGRADE_HEADROOM 0.5f    // "Well inside": under this fraction of the budget
+
+// What the render task knows about the audio right now
+struct AudioFeatures {
+  uint32_t now;                 // Milliseconds
+  float level;                  // Smoothed volume, kicked up instantly by onsets
+  float volumePeak;             // Running peak of the smoothed volume
+  bool silent;                  // Below the noise gate
+  float bands[SPECTRUM_BANDS];  // Band energies, 0..1 of the range shown below each band's peak
+  float goertzelBands[GOERTZEL_BANDS];  // Smoothed Goertzel band levels (kick, bass, mid, presence, air), 0..1
+  bool beat;                    // An onset arrived since the last frame
+  float bpm;                    // Tracked tempo, 0 without a lock
+  float beatPhase;              // 0..1 within the current beat
+  float barPhase;               // 0..1 within the current bar
+};
+
+// Logical pixels at 16 bits per channel (Color16, see color.h), kept
+// between frames so effects can draw incrementally or fade what is already
+// there. Fades and level-driven brightness keep their fraction below the
+// strip's 8 bits, which the sink's dithering then spreads over frames.
+class FrameBuffer {
+public:
+  static constexpr int count = LED_COUNT;
+
+  // 0x00RRGGBB, for drawing code that only has 8-bit colors
+  void setPixel(uint16_t index, uint32_t color) { setPixel16(index, color16(color)); }
+
+  void setPixel16(uint16_t index, Color16 color) {
+    if (index < LED_COUNT) {
+      pixels[index] = color;
+    }
+  }
+  Color16 getPixel(uint16_t index) const { return index < LED_COUNT ? pixels[index] : 0; }
+  Color16* data() { return pixels; }
+  const Color16* data() const { return pixels; }
+  void clear() { memset(pixels, 0, sizeof(pixels)); }
+
+private:
+  Color16 pixels[LED_COUNT] = {0};
+};
+
+class Effect {
+public:
+  virtual ~Effect() {}
+  virtual const char* name() const = 0;
+
+  // Levels run from 0 (best) to qualityLevels() - 1 (cheapest)
+  virtual int qualityLevels() const { return 1; }
+
+  // Called on selection; the frame buffer has just been cleared
+  virtual void begin() {}
+
+  virtual void render(const AudioFeatures& features, FrameBuffer& frame, int quality) = 0;
+
+  // Console keys the engine does not use. Returns true when handled.
+  virtual bool command(int) { return false; }
+};
+
+// Timing of the current effect since the last takeStats() call
+struct EffectStats {
+  uint32_t frames;          // Frames rendered
+  uint32_t skipped;         // Frames skipped for overrunning at the cheapest level
+  uint32_t renderMicros;    // Average render time
+  uint32_t maxRenderMicros;
+  uint32_t outputMicros;    // Average time to push pixels and show them
+  uint32_t budgetMicros;    // Render budget at the end of the window
+  uint32_t downgrades;      // Quality level drops
+};
+
+class EffectEngine {
+public:
+  bool add(Effect* effect);
+  void select(int index);
+  bool select(const char* name);
+  void next();
+
+  Effect& current() { return *effects[active]; }
+  int quality() const { return qualityLevel; }
+
+  // Forwards a console key to the current effect
+  bool command(int key) { return current().command(key); }
+
+  // Renders one frame of at most frameMicros, including output
+  void renderFrame(const AudioFeatures& features, LedSink& leds, uint32_t frameMicros);
+
+  EffectStats takeStats();
+
+  // Pixels not black in the last frame pushed to the sink
+  int litPixels() const;
+
+private:
+  void adaptQuality(uint32_t renderMicros, uint32_t budgetMicros);
+
+  Effect* effects[EFFECT_MAX] = {0};
+  int effectCount = 0;
+  int active = 0;
+  int qualityLevel = 0;
+
+  FrameBuffer frame;
+  Color16 shown[LED_COUNT] = {0};  // Pixels last pushed to the sink
+
+  int overruns = 0;           // Consecutive frames over budget
+  int comfortableFrames = 0;  // Consecutive frames well inside it
+  bool skipNext = false;
+  float outputMicros = 0;     // Smoothed output time
+
+  EffectStats window = {};
+  uint64_t windowRenderMicros = 0;
+  uint64_t windowOutputMicros = 0;
+};
+
+// Registers the built-in effects, in the order 's' cycles through them
+void registerEffects(EffectEngine& engine);
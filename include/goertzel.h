@@ -0,0 +1,93 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rms.h"
+
+// ===============================
+// GOERTZEL FILTER BANK
+// ===============================
+// Tracks the energy at N fixed frequencies. Cheaper than an FFT when only a
+// handful of bands are needed, and it runs inside the RMS pass so every
+// sample is loaded once.
+template <size_t N>
+class GoertzelBank {
+public:
+  void begin(const float (&frequencies)[N], float sampleRate, uint32_t windowLength) {
+    window = windowLength;
+    for (size_t b = 0; b < N; b++) {
+      // Tuned to the frequency itself, not the nearest bin of the window: at
+      // 1024 samples the bins are 43 Hz apart, which would move 60 Hz to 43
+      coeff[b] = 2.0f * cosf(2.0f * (float)M_PI * frequencies[b] / sampleRate);
+      energy[b] = 0;
+    }
+    reset();
+  }
+
+  // RMS of the block exactly as rmsQ31() computes it, while advancing every
+  // Goertzel resonator by the same samples. Spikes count as silence for the
+  // resonators. Sets ready() when a window has completed.
+  BlockRms process(const int32_t* samples, size_t count, int shift, uint32_t spikeLimit) {
+    uint64_t sumSquares = 0;
+    uint16_t validSamples = 0;
+    ready = false;
+
+    for (size_t i = 0; i < count; ++i) {
+      int32_t sample = samples[i] >> shift;
+      uint32_t magnitude = sample < 0 ? (uint32_t)(-sample) : (uint32_t)sample;
+      if (magnitude < spikeLimit) {
+        sumSquares += (uint64_t)magnitude * magnitude;
+        validSamples++;
+      } else {
+        sample = 0;
+      }
+
+      float x = (float)sample;
+      for (size_t b = 0; b < N; b++) {
+        float s0 = x + coeff[b] * s1[b] - s2[b];
+        s2[b] = s1[b];
+        s1[b] = s0;
+      }
+
+      if (++filled == window) {
+        finishWindow();
+      }
+    }
+
+    return finishRms(sumSquares, validSamples);
+  }
+
+  bool isReady() const { return ready; }
+
+  // RMS of each tracked tone over the last completed window, in sample units
+  const float* energies() const { return energy; }
+
+private:
+  void finishWindow() {
+    float scale = 1.0f / window;
+    for (size_t b = 0; b < N; b++) {
+      float power = s1[b] * s1[b] + s2[b] * s2[b] - coeff[b] * s1[b] * s2[b];
+      energy[b] = power > 0 ? sqrtf(2.0f * power) * scale : 0;
+    }
+    reset();
+    ready = true;
+  }
+
+  void reset() {
+    for (size_t b = 0; b < N; b++) {
+      s1[b] = 0;
+      s2[b] = 0;
+    }
+    filled = 0;
+  }
+
+  float coeff[N];
+  float s1[N];
+  float s2[N];
+  float energy[N];
+  uint32_t window = 0;
+  uint32_t filled = 0;
+  bool ready = false;
+};
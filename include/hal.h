@@ -0,0 +1,114 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ===============================
+// HARDWARE ABSTRACTION LAYER
+// ===============================
+// The pipeline in main.cpp only talks to these interfaces. The ESP32
+// implementations live in hal_esp32.cpp, the native host ones (WAV input,
+// LED frames written to a file, state kept in a file) in hal_native.cpp.
+
+// What became available since the last waitForBlocks() call
+struct CaptureBatch {
+  int readyBlocks;          // Blocks that can be read without blocking
+  uint32_t overflows;       // Input overflow events
+  uint32_t droppedSamples;  // Samples lost to those overflows
+};
+
+class AudioSource {
+public:
+  virtual ~AudioSource() {}
+  virtual bool begin() = 0;
+
+  // Sleeps until at least one block is ready. Returns false once the
+  // source is exhausted and no more blocks will arrive.
+  virtual bool waitForBlocks(CaptureBatch& batch) = 0;
+
+  // Copies one ready block of raw Q31 words without blocking.
+  // Returns the number of samples copied, 0 when nothing is ready.
+  virtual size_t readBlock(int32_t* dst, size_t maxSamples) = 0;
+
+  // Throws away everything captured so far and its notifications, e.g.
+  // what queued up while nobody was reading. Returns the samples thrown
+  // away, so sample indices keep counting from the start of capture.
+  virtual uint32_t discardPending() = 0;
+
+  // When sample `index` (counting every sample since capture started,
+  // read, discarded or dropped) entered the input, on the micros() clock.
+  // The ESP32 derives it from the I2S sample clock, the host from the
+  // replay position (modeled).
+  virtual uint32_t sampleMicros(uint64_t index) = 0;
+  virtual bool sampleTimesModeled() = 0;
+};
+
+class Clock {
+public:
+  virtual ~Clock() {}
+  virtual uint32_t millis() = 0;
+  virtual uint32_t micros() = 0;
+  // CPU cycles on the ESP32, nanoseconds on the host
+  virtual uint32_t cycles() = 0;
+  virtual uint32_t cyclesPerMicrosecond() = 0;
+  virtual void delay(uint32_t ms) = 0;
+};
+
+// Cumulative output timing since begin()
+struct LedStats {
+  uint32_t frames;          // Frames passed to show()
+  uint32_t skipped;         // Frames identical to the previous one, not sent
+  uint32_t waits;           // Frames that found the previous one still streaming
+  uint64_t waitMicros;      // Total time show() spent waiting for it
+  uint32_t maxWaitMicros;   // Longest single wait
+  uint32_t transferMicros;  // Wire time of the last frame including the latch
+  bool transferModeled;     // transferMicros is computed, not timed (the host)
+};
+
+class LedSink {
+public:
+  virtual ~LedSink() {}
+  virtual void begin() = 0;
+  virtual void clear() = 0;
+  virtual void setPixel(uint16_t index, uint32_t color) = 0;  // 0x00RRGGBB
+  // Full-precision variant, 0xFFFF per channel is full on
+  virtual void setPixel16(uint16_t index, uint16_t r, uint16_t g, uint16_t b) = 0;
+  // Queues the frame for output and returns; the next frame can be drawn
+  // while this one is on the wire
+  virtual void show() = 0;
+  virtual void service() = 0;
+  virtual LedStats stats() = 0;
+};
+
+#define LOG_LINE_MAX 256  // Longer lines are truncated
+
+class Log {
+public:
+  virtual ~Log() {}
+  virtual void write(const char* text, size_t length) = 0;
+  // Binary telemetry, queued with logFrame() and written by the log drain
+  // between text lines, so it may wait on the output like write()
+  virtual void writeFrame(const uint8_t* data, size_t length) = 0;
+  // Next byte typed by the operator, -1 when there is none
+  virtual int read() = 0;
+  void printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+// One blob of state that survives a reboot (NVS on the ESP32)
+class Storage {
+public:
+  virtual ~Storage() {}
+  // Returns false when nothing of exactly this length was stored
+  virtual bool load(void* data, size_t length) = 0;
+  virtual bool save(const void* data, size_t length) = 0;
+};
+
+namespace hal {
+void begin();
+AudioSource& audio();
+Clock& clock();
+LedSink& leds();
+Log& log();
+Storage& storage();
+}
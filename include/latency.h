@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+
+// ===============================
+// LATENCY PROBE
+// ===============================
+// Measures mic-to-LED delay end to end. 'l' on the console starts a series
+// of LATENCY_PROBE_COUNT probes. For each one the audio task overwrites the
+// next LATENCY_PROBE_MS of captured samples with a burst of white noise,
+// so the burst takes the same path as sound from the microphone. Every
+// hand-off stamps hal::clock().micros() until the first frame where the
+// LEDs react (LATENCY_PROBE_LEDS more pixels lit than when the burst
+// arrived), and each probe logs its delay split into stages:
+//   capture    first burst sample in the mic to its block leaving DMA, from
+//              its sample index on the I2S clock, so a DMA backlog counts
+//   analysis   RMS, FFT, filters and onset detection on that block
+//   queue      waiting in the frame queue for the render task
+//   smoothing  further blocks until the level had risen enough to show
+//   frame wait the rest of the frame interval before the next render
+//   render     effect render, pushing pixels and show()
+//   wire       shifting the frame out to the strip
+// Stages that are computed rather than timed are marked with a * in the
+// report. On the host that is capture and wire, and since its clock only
+// advances with the replayed audio, analysis, queue and render read 0.
+// Run it in a quiet room: a burst over music may be hidden or beaten by it.
+// The native build takes console keys with -k, so `-k l` measures a replay.
+
+enum LatencyStage {
+  LATENCY_CAPTURE,
+  LATENCY_ANALYSIS,
+  LATENCY_QUEUE,
+  LATENCY_SMOOTHING,
+  LATENCY_FRAME_WAIT,
+  LATENCY_RENDER,
+  LATENCY_WIRE,
+  LATENCY_STAGES
+};
+
+struct LatencyStamps {
+  uint32_t captured;   // First burst sample reached the microphone
+  uint32_t read;       // Its block was copied out of DMA
+  uint32_t published;  // The block's features were queued
+  uint32_t consumed;   // The render task took them
+  uint32_t triggered;  // Took the frame whose level the LEDs reacted to
+  uint32_t rendered;   // The reacting render pass started
+  uint32_t shown;      // show() returned
+  uint32_t latched;    // The frame was on the strip
+  uint8_t modeled;     // 1 << LatencyStage for each stage that is modeled
+};
+
+// Fills count samples with random-sign noise of the given RMS, as the
+// left-justified words the microphone delivers
+void latencyFillBurst(int32_t* samples, int count, int32_t level, int shift);
+
+// Starts a new series
+void latencyBegin();
+
+// Logs one probe's breakdown and adds it to the series
+void latencyRecord(const LatencyStamps& stamps);
+
+// A probe the LEDs never reacted to
+void latencyMissed();
+
+// Logs the series average per stage
+void latencySummary();
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+
+// ===============================
+// VOLUME TO LED MAPPING CURVES
+// ===============================
+// Each curve is baked into a table of LED counts indexed by normalized
+// volume, so the render path does one multiply and one lookup whatever the
+// curve. The table only depends on the curve and the LED count; the volume
+// scale is refreshed when the peak has moved by more than CURVE_PEAK_CHANGE.
+#define CURVE_TABLE_SIZE 512      // Normalized volume steps
+#define CURVE_PEAK_CHANGE 0.02f   // Relative peak movement that rescales
+#define CURVE_FULL_FRACTION 0.95f // Fraction of the peak that lights everything
+#define CURVE_POWER_EXPONENT 0.7f
+#define CURVE_DB_RANGE 30.0f      // dB below the peak shown by the dB curve
+#define CURVE_KNEE_RATIO 3.0f     // How hard the soft knee bends the top
+
+enum VuCurve : uint8_t {
+  CURVE_POWER,      // x^0.7, the gentle curve the VU always had
+  CURVE_DB,         // Linear in decibels over CURVE_DB_RANGE
+  CURVE_S,          // Smoothstep: quiet and loud compressed, middle stretched
+  CURVE_SOFT_KNEE,  // Linear at the bottom, bending into compression at the top
+  CURVE_COUNT
+};
+
+class LevelMapper {
+public:
+  void begin(VuCurve curve, float floor, uint16_t ledCount);
+
+  // Rebuilds the table; costs CURVE_TABLE_SIZE curve evaluations
+  void setCurve(VuCurve curve);
+  VuCurve curve() const { return current; }
+  static const char* curveName(VuCurve curve);
+
+  // Cheap unless the peak moved by more than CURVE_PEAK_CHANGE
+  void setPeak(float peak);
+
+  // LEDs to light for a volume level: 0 at or below the floor, then 1 up
+  // to all of them at CURVE_FULL_FRACTION of the peak
+  uint16_t ledsFor(float level) const {
+    if (level <= floor || !scaled) {
+      return 0;
+    }
+    if (level >= fullLevel) {
+      return ledCount;
+    }
+    uint32_t index = (uint32_t)((level - floor) * indexScale + 0.5f);
+    return table[index < CURVE_TABLE_SIZE ? index : CURVE_TABLE_SIZE - 1];
+  }
+
+  uint32_t tableBuilds() const { return builds; }
+  uint32_t rescales() const { return peakUpdates; }
+
+private:
+  static float shape(VuCurve curve, float x);
+
+  uint16_t table[CURVE_TABLE_SIZE] = {0};
+  VuCurve current = CURVE_POWER;
+  uint16_t ledCount = 0;
+  float floor = 0;
+  float peak = 0;          // Peak the scale was last computed for
+  float indexScale = 0;    // Table steps per unit of volume above the floor
+  float fullLevel = 0;
+  bool scaled = false;     // The peak is above the floor
+  uint32_t builds = 0;
+  uint32_t peakUpdates = 0;
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <type_traits>
+#include <utility>
+
+// ===============================
+// ASYNCHRONOUS LOGGING
+// ===============================
+// LOG_ERROR(...) to LOG_DEBUG(...) take printf arguments but do not format
+// anything: they copy the format pointer and the raw argument values into a
+// record on a lock-free ring, a few dozen cycles. logDrain() formats and
+// writes queued records to the HAL log; on the ESP32 a low-priority task
+// runs it, on the host loop() does. A full ring drops the record and counts
+// it, so a blocked UART can never stall capture or rendering.
+//
+// Formatting happens later, so %s arguments must outlive the record:
+// literals, names from static tables, or strings that live for the run.
+//
+// Until logDefer() is called (at the end of setup) records are formatted
+// and written on the spot, so setup and the benchmarks keep their output.
+enum LogLevel : uint8_t {
+  LOG_LEVEL_ERROR,
+  LOG_LEVEL_WARN,
+  LOG_LEVEL_INFO,
+  LOG_LEVEL_DEBUG,  // Periodic statistics and the plotter line
+  LOG_LEVEL_COUNT
+};
+
+#define LOG_MAX_ARGS 12
+
+union LogArg {
+  long long i;
+  unsigned long long u;
+  double d;
+  const void* p;
+};
+
+typedef int (*LogFormatter)(char* out, size_t size, const char* format, const LogArg* args);
+
+struct LogRecord {
+  const char* format;
+  LogFormatter formatter;  // Knows the argument types the record was posted with
+  LogArg args[LOG_MAX_ARGS];
+};
+
+LogLevel logLevel();
+void setLogLevel(LogLevel level);
+const char* logLevelName(LogLevel level);
+
+void logDefer();
+void logSubmit(const LogRecord& record);
+
+// Queues a binary frame (telemetry) to be written in order with the text
+// through Log::writeFrame. It ignores the level, and a full ring drops the
+// frame and returns false instead of counting a lost message.
+#define LOG_FRAME_MAX (sizeof(LogArg) * (LOG_MAX_ARGS - 1))
+bool logFrame(const uint8_t* data, size_t length);
+
+// Formats and writes everything queued. Returns the number of records written.
+int logDrain();
+
+// Records lost to a full ring since boot
+uint32_t logDropped();
+
+template <typename T>
+LogArg logPack(T value) {
+  LogArg arg;
+  if constexpr (std::is_floating_point<T>::value) {
+    arg.d = value;
+  } else if constexpr (std::is_pointer<T>::value) {
+    arg.p = value;
+  } else if constexpr (std::is_signed<T>::value || std::is_enum<T>::value) {
+    arg.i = value;
+  } else {
+    arg.u = value;
+  }
+  return arg;
+}
+
+template <typename T>
+T logUnpack(const LogArg& arg) {
+  if constexpr (std::is_floating_point<T>::value) {
+    return arg.d;
+  } else if constexpr (std::is_pointer<T>::value) {
+    return (T)arg.p;
+  } else if constexpr (std::is_signed<T>::value || std::is_enum<T>::value) {
+    return (T)arg.i;
+  } else {
+    return (T)arg.u;
+  }
+}
+
+template <typename... Args, size_t... I>
+int logFormatArgs(char* out, size_t size, const char* format, const LogArg* args, std::index_sequence<I...>) {
+  return snprintf(out, size, format, logUnpack<Args>(args[I])...);
+}
+
+template <typename... Args>
+int logFormat(char* out, size_t size, const char* format, const LogArg* args) {
+  if constexpr (sizeof...(Args) == 0) {
+    return snprintf(out, size, "%s", format);
+  } else {
+    return logFormatArgs<Args...>(out, size, format, args, std::index_sequence_for<Args...>{});
+  }
+}
+
+template <typename... Args>
+void logPost(LogLevel level, const char* format, Args... args) {
+  static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "Too many log arguments");
+  static_assert(((std::is_arithmetic<Args>::value || std::is_enum<Args>::value || std::is_pointer<Args>::value) && ...),
+                "Log arguments must be numbers or pointers");
+  if (level > logLevel()) {
+    return;
+  }
+  LogRecord record;
+  record.format = format;
+  record.formatter = logFormat<Args...>;
+  int index = 0;
+  ((record.args[index++] = logPack(args)), ...);
+  (void)index;
+  logSubmit(record);
+}
+
+// Never called; lets the compiler check LOG_* formats as it does printf's
+inline void __attribute__((format(printf, 1, 2))) logCheckFormat(const char*, ...) {}
+
+#define LOG_AT(level, ...)                  \
+  do {                                      \
+    if (false) logCheckFormat(__VA_ARGS__); \
+    logPost(level, __VA_ARGS__);            \
+  } while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "hal.h"
+
+// ===============================
+// LED MATRIX CANVAS
+// ===============================
+// Renderers draw at logical (x, y), origin top left, as the panel is seen.
+// How the panel is wired and mounted is described by a set of flags, and
+// the logical-to-strip-index table is built from them at compile time.
+#define WIRING_SERPENTINE 0x01  // Every other row runs backwards
+#define WIRING_FLIP_X 0x02      // Mirror left/right
+#define WIRING_FLIP_Y 0x04      // Mirror top/bottom
+#define WIRING_ROTATE_90 0x08   // Panel mounted a quarter turn clockwise
+#define WIRING_ROTATE_180 0x10
+#define WIRING_ROTATE_270 0x18
+#define WIRING_ROTATION_MASK 0x18
+
+template <int Width, int Height>
+struct XyTable {
+  uint16_t index[Width * Height];  // Strip index of logical pixel y * Width + x
+};
+
+template <int Width, int Height>
+constexpr XyTable<Width, Height> makeXyTable(int wiring) {
+  XyTable<Width, Height> table = {};
+  int turns = (wiring & WIRING_ROTATION_MASK) / WIRING_ROTATE_90;
+  // Rows as wired: a quarter turn swaps the panel's own width and height
+  int rowLength = turns % 2 == 0 ? Width : Height;
+
+  for (int y = 0; y < Height; y++) {
+    for (int x = 0; x < Width; x++) {
+      int fx = (wiring & WIRING_FLIP_X) ? Width - 1 - x : x;
+      int fy = (wiring & WIRING_FLIP_Y) ? Height - 1 - y : y;
+
+      // Logical position in the panel's own coordinates
+      int px = fx;
+      int py = fy;
+      if (turns == 1) {
+        px = fy;
+        py = Width - 1 - fx;
+      } else if (turns == 2) {
+        px = Width - 1 - fx;
+        py = Height - 1 - fy;
+      } else if (turns == 3) {
+        px = Height - 1 - fy;
+        py = fx;
+      }
+
+      if ((wiring & WIRING_SERPENTINE) && py % 2 == 1) {
+        px = rowLength - 1 - px;
+      }
+      table.index[y * Width + x] = py * rowLength + px;
+    }
+  }
+  return table;
+}
+
+template <int Width, int Height, int Wiring>
+class MatrixCanvas {
+public:
+  static constexpr int width = Width;
+  static constexpr int height = Height;
+
+  // Target is anything with setPixel(index, color): an LedSink or a FrameBuffer
+  template <typename Target>
+  static void setPixel(Target& leds, int x, int y, uint32_t color) {
+    leds.setPixel(table.index[y * Width + x], color);
+  }
+
+private:
+  static constexpr XyTable<Width, Height> table = makeXyTable<Width, Height>(Wiring);
+};
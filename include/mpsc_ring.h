@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// ===============================
+// MULTI-PRODUCER / SINGLE-CONSUMER RING
+// ===============================
+// Lock-free bounded queue that any task may push to and one task drains.
+// Each slot carries a sequence number: producers claim a slot by advancing
+// the head with a compare-and-swap, fill it, then publish it by bumping its
+// sequence. The consumer only takes a slot once it has been published, so
+// items come out in claim order even when producers finish out of order.
+// push() never blocks: when the ring is full it returns false.
+template <typename T, size_t N>
+class MpscRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "MpscRing size must be a power of two");
+
+public:
+  MpscRing() {
+    for (size_t i = 0; i < N; i++) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Producer side, any task
+  bool push(const T& item) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+      cell = &cells_[head & (N - 1)];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t lag = (intptr_t)sequence - (intptr_t)head;
+      if (lag == 0) {
+        if (head_.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (lag < 0) {
+        return false;  // Full: the slot still holds an item from the last lap
+      } else {
+        head = head_.load(std::memory_order_relaxed);  // Another producer got there first
+      }
+    }
+    cell->item = item;
+    cell->sequence.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side
+  bool pop(T& item) {
+    Cell& cell = cells_[tail_ & (N - 1)];
+    if (cell.sequence.load(std::memory_order_acquire) != tail_ + 1) {
+      return false;  // Empty, or the next slot is still being filled
+    }
+    item = cell.item;
+    cell.sequence.store(tail_ + N, std::memory_order_release);
+    tail_++;
+    return true;
+  }
+
+  static constexpr size_t capacity() { return N; }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T item;
+  };
+
+  Cell cells_[N];
+  std::atomic<size_t> head_{0};  // Next slot to claim, shared by producers
+  size_t tail_ = 0;              // Consumer only
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ===============================
+// ONSET DETECTOR
+// ===============================
+// Half-wave rectified spectral flux over log band energies, compared with
+// an adaptive threshold taken from the running median of recent flux.
+#define ONSET_MAX_BANDS 16
+#define ONSET_MEDIAN_WINDOW 64      // Flux values in the threshold history
+#define ONSET_THRESHOLD_SCALE 3.0f  // Threshold = median * scale + offset
+#define ONSET_THRESHOLD_OFFSET 20.0f  // In summed dB of rise
+#define ONSET_MIN_GAP 4410          // Refractory period in samples (100 ms)
+#define ONSET_PEAK_BLOCKS 16        // Recent block peaks kept for timestamping
+
+struct OnsetEvent {
+  uint64_t sampleIndex;  // Sample at which the transient peaks
+  float strength;        // Flux divided by the threshold (> 1)
+};
+
+class OnsetDetector {
+public:
+  // Records a block's loudest sample so onsets can be placed within a hop
+  void addBlock(const int32_t* samples, size_t count, int shift, uint64_t sampleIndex);
+
+  // Feeds one feature vector (band energies in dB) covering the `hopSamples`
+  // samples that end at `hopEnd`. Returns true and fills `event` on an onset.
+  bool process(const float* bandsDb, int bandCount, uint64_t hopEnd, uint32_t hopSamples, OnsetEvent& event);
+
+  float flux() const { return lastFlux; }
+  float threshold() const { return lastThreshold; }
+  uint32_t onsetCount() const { return onsets; }
+
+private:
+  float median();
+  uint64_t locate(uint64_t hopStart, uint64_t hopEnd);
+
+  float previous[ONSET_MAX_BANDS] = {0};  // Band energies one hop ago
+  float older[ONSET_MAX_BANDS] = {0};     // ... and two hops ago
+  bool primed = false;
+
+  float history[ONSET_MEDIAN_WINDOW] = {0};
+  float scratch[ONSET_MEDIAN_WINDOW];
+  int historyIndex = 0;
+  int historyCount = 0;
+
+  uint64_t peakSample[ONSET_PEAK_BLOCKS] = {0};
+  uint32_t peakLevel[ONSET_PEAK_BLOCKS] = {0};
+  int peakIndex = 0;
+
+  float lastFlux = 0;
+  float lastThreshold = 0;
+  uint64_t lastOnset = 0;
+  bool anyOnset = false;
+  volatile uint32_t onsets = 0;
+};
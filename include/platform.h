@@ -0,0 +1,31 @@
+#pragma once
+
+// Pulls in the Arduino core on the ESP32. On the native host it provides
+// the few Arduino helpers the shared pipeline code relies on instead.
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+
+using std::abs;
+using std::max;
+using std::min;
+
+template <typename T, typename L, typename H>
+inline T constrain(T value, L low, H high) {
+  return value < low ? (T)low : (value > high ? (T)high : value);
+}
+#endif
+
+// Work is split across pinned FreeRTOS tasks on the ESP32; the native host
+// runs capture and rendering back to back from loop()
+#ifdef ARDUINO
+#define LIGHTSHOW_TASKS 1
+#else
+#define LIGHTSHOW_TASKS 0
+#endif
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "trace.h"
+
+// ===============================
+// STAGE PROFILER
+// ===============================
+// Build with -D LIGHTSHOW_PROFILE to time each pipeline stage. PROFILE_SCOPE
+// reads the cycle counter (a steady nanosecond clock on the host) on entry
+// and exit and files the duration in the stage's log2 histogram: bucket b
+// holds durations of 2^(b-1) up to 2^b - 1 cycles. 'p' on the console
+// dumps count, min, p50, p99 and max per stage and starts a new window.
+// Percentiles come from the buckets, so they are upper bounds within a
+// factor of two. Without the flag the probes compile to nothing.
+// With -D LIGHTSHOW_TRACE the same probes also record trace events.
+//
+// Every stage is recorded by one task only. A dump reads the others'
+// histograms as they are, and each task clears its own on the next record
+// after a dump, so no histogram has two writers.
+enum ProfileStage {
+  // Audio task
+  STAGE_I2S_WAIT,    // Waiting for DMA blocks
+  STAGE_I2S_READ,    // Copying a block out of DMA
+  STAGE_RMS,         // RMS and the Goertzel bank
+  STAGE_FILTER,      // Volume filter chain
+  STAGE_FFT,         // Spectrum analyzer
+  STAGE_ONSET,
+  STAGE_TEMPO,
+  // Render task
+  STAGE_RENDER,      // Whole render pass
+  STAGE_CONSUME,     // Draining the frame queue
+  STAGE_EFFECT,      // Effect render
+  STAGE_LED_SHOW,    // Pushing pixels and show()
+  STAGE_LED_SERVICE,
+  STAGE_TELEMETRY,
+  STAGE_REPORTS,     // Periodic statistics
+  // Log task
+  STAGE_LOG,         // Formatting and writing one message
+  STAGE_COUNT
+};
+
+inline const char* profileStageName(ProfileStage stage) {
+  static const char* const names[] = {
+    "i2s wait", "i2s read", "rms", "filter", "fft", "onset", "tempo",
+    "render", "consume", "effect", "led show", "led service", "telemetry", "reports",
+    "log",
+  };
+  static_assert(sizeof(names) / sizeof(names[0]) == STAGE_COUNT, "One name per profile stage");
+  return names[stage];
+}
+
+#ifdef LIGHTSHOW_PROFILE
+
+#include "hal.h"
+
+#define PROFILE_BUCKETS 33  // Zero, then one per bit of a 32-bit count
+
+void profileRecord(ProfileStage stage, uint32_t cycles);
+
+// Logs every stage that ran since the last dump and starts a new window
+void profileDump();
+
+class ProfileScope {
+public:
+  explicit ProfileScope(ProfileStage stage) : stage(stage), start(hal::clock().cycles()) {}
+  ~ProfileScope() { profileRecord(stage, hal::clock().cycles() - start); }
+
+private:
+  ProfileStage stage;
+  uint32_t start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_HISTOGRAM_SCOPE(stage) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(stage)
+#define PROFILE_HISTOGRAM_SPAN(stage, start, end) profileRecord(stage, (end) - (start))
+
+#else
+
+#define PROFILE_HISTOGRAM_SCOPE(stage) ((void)0)
+#define PROFILE_HISTOGRAM_SPAN(stage, start, end) ((void)0)
+
+#endif
+
+#define PROFILE_SCOPE(stage)      \
+  PROFILE_HISTOGRAM_SCOPE(stage); \
+  TRACE_SCOPE(stage)
+
+// For code that already read the cycle counter around the stage
+#define PROFILE_SPAN(stage, start, end)        \
+  do {                                         \
+    PROFILE_HISTOGRAM_SPAN(stage, start, end); \
+    TRACE_SPAN(stage, start, end);             \
+  } while (0)
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ===============================
+// FIXED-POINT RMS KERNEL
+// ===============================
+
+struct BlockRms {
+  uint32_t rms;           // RMS of the accepted samples, in shifted sample units
+  uint16_t validSamples;  // Samples that passed the spike filter
+};
+
+// RMS over raw Q31 I2S words without touching the FPU. Each word is
+// shifted right by `shift`, samples whose magnitude reaches `spikeLimit`
+// are skipped, and the rest are squared into a 64-bit accumulator.
+// The result is rounded to the nearest integer.
+BlockRms rmsQ31(const int32_t* samples, size_t count, int shift, uint32_t spikeLimit);
+
+// Final step of rmsQ31(), for kernels that fuse their own pass over the block
+BlockRms finishRms(uint64_t sumSquares, uint16_t validSamples);
+
+// Integer square root, rounded to nearest and saturating at UINT32_MAX
+uint32_t isqrt64(uint64_t value);
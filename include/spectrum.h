@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ===============================
+// FFT SPECTRUM ANALYZER
+// ===============================
+#define FFT_SIZE 512          // Real FFT length (power of two)
+#define FFT_HOP 256           // New samples between FFTs (50% overlap)
+#define SPECTRUM_BANDS 12     // Log-spaced output bands
+#define SPECTRUM_MIN_HZ 40
+#define SPECTRUM_MAX_HZ 16000
+
+class SpectrumAnalyzer {
+public:
+  // Builds the window, twiddle and band tables
+  void begin(float sampleRate);
+
+  // Feeds raw Q31 words. Returns true when a new set of bands is ready.
+  bool addSamples(const int32_t* samples, size_t count, int shift);
+
+  // Band energies in dB from the most recent FFT
+  const float* bands() const { return bandDb; }
+
+  // Cost accounting, read from any task
+  uint32_t fftCount() const { return ffts; }
+  uint32_t totalCycles() const { return cycles; }
+
+private:
+  void runFft();
+  void transform();
+
+  float history[FFT_SIZE];     // Most recent samples, oldest first
+  size_t pending = 0;          // Samples received since the last FFT
+  float window[FFT_SIZE];      // Hann window
+  float re[FFT_SIZE / 2];      // Half-length complex work buffer
+  float im[FFT_SIZE / 2];
+  float cosTable[FFT_SIZE / 2];
+  float sinTable[FFT_SIZE / 2];
+  uint16_t bitReverse[FFT_SIZE / 2];
+  uint16_t bandStart[SPECTRUM_BANDS + 1];  // First bin of each band, plus end
+  float bandDb[SPECTRUM_BANDS];
+
+  volatile uint32_t ffts = 0;
+  volatile uint32_t cycles = 0;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+
+// ===============================
+// SINGLE-PRODUCER / SINGLE-CONSUMER RING
+// ===============================
+// Lock-free bounded queue for handing data from exactly one producer task
+// to exactly one consumer task. push() never blocks: when the ring is full
+// it returns false and the caller decides what to count as dropped.
+template <typename T, size_t N>
+class SpscRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+  // Producer side
+  bool push(const T& item) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    if (head - tail >= N) {
+      return false;  // Full
+    }
+    items_[head & (N - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side
+  bool pop(T& item) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_acquire);
+    if (tail == head) {
+      return false;  // Empty
+    }
+    item = items_[tail & (N - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Safe to call from either side; the value may be stale by the time it is used
+  size_t size() const {
+    size_t head = head_.load(std::memory_order_acquire);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    return head - tail;
+  }
+
+  static constexpr size_t capacity() { return N; }
+
+private:
+  T items_[N];
+  std::atomic<size_t> head_{0};  // Written by producer only
+  std::atomic<size_t> tail_{0};  // Written by consumer only
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ===============================
+// BINARY TELEMETRY
+// ===============================
+// One small frame per LED frame instead of a formatted plotter line. The
+// payload is a fixed little-endian record of fixed-point integers followed
+// by a CRC-16, COBS encoded so it contains no zero bytes, with a zero byte
+// on each side. Log text shares the serial port and never contains zeros,
+// so a decoder splits the stream at zeros, keeps the chunks that decode
+// with a good CRC and passes everything else through as text.
+//
+// Payload (schema 1):
+//   0  u8   schema
+//   1  u16  sequence, wraps; gaps are dropped frames
+//   3  u32  time in ms
+//   7  u16  volume x 10
+//   9  u16  smoothed volume x 10
+//   11 u16  smoothed volume peak x 10
+//   13 u16  CRC-16/CCITT-FALSE over bytes 0..12
+// tools/telemetry_decode.cpp turns a capture back into CSV or plotter text.
+#define TELEMETRY_SCHEMA 1
+#define TELEMETRY_VOLUME_SCALE 10  // Fixed point: 0.1 steps up to 6553.5
+#define TELEMETRY_PAYLOAD_SIZE 15  // Including the CRC
+#define TELEMETRY_FRAME_MAX (TELEMETRY_PAYLOAD_SIZE + 1 + 2)  // COBS overhead and both delimiters
+
+struct TelemetrySample {
+  uint16_t sequence;
+  uint32_t timeMs;
+  float volume;
+  float smoothVolume;
+  float smoothPeak;
+};
+
+uint16_t crc16(const uint8_t* data, size_t length);
+
+// COBS for blocks under 254 bytes. Encoding writes length + 1 bytes;
+// decoding returns the decoded length, 0 for a malformed block.
+size_t cobsEncode(const uint8_t* in, size_t length, uint8_t* out);
+size_t cobsDecode(const uint8_t* in, size_t length, uint8_t* out);
+
+// Writes a complete frame, delimiters included, and returns its length
+size_t telemetryEncode(const TelemetrySample& sample, uint8_t* frame);
+
+// Decodes the bytes between two delimiters. Returns false for anything that
+// is not a frame of this schema with a good CRC.
+bool telemetryDecode(const uint8_t* chunk, size_t length, TelemetrySample& sample);
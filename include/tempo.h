@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ===============================
+// TEMPO TRACKER
+// ===============================
+// Estimates BPM from the autocorrelation of the onset envelope and keeps a
+// beat clock phase-locked to detected onsets. The autocorrelation is
+// computed a few lags per hop, so the per-hop cost stays flat.
+#define TEMPO_ENVELOPE_LEN 1024   // Onset envelope history (~5.9 s at 256-sample hops)
+#define TEMPO_MIN_BPM 70
+#define TEMPO_MAX_BPM 180
+#define TEMPO_LAGS_PER_HOP 4      // Autocorrelation lags evaluated per envelope value
+#define TEMPO_MIN_CONFIDENCE 0.1f // Normalized autocorrelation peak needed to lock
+#define TEMPO_LOCK_WINDOW 0.2f    // Onsets within this fraction of a beat steer the clock
+#define TEMPO_PHASE_GAIN 0.25f    // PLL phase correction per onset
+#define TEMPO_PERIOD_GAIN 0.05f   // PLL period correction per onset
+#define TEMPO_BEATS_PER_BAR 4
+
+class TempoTracker {
+public:
+  // `hopSamples` is the spacing of the envelope values fed to addEnvelope()
+  void begin(float sampleRate, uint32_t hopSamples);
+
+  // Adds one onset-envelope value for the hop ending at `hopEnd`
+  void addEnvelope(float value, uint64_t hopEnd);
+
+  // Steers the beat clock towards an onset at `sampleIndex`
+  void addOnset(uint64_t sampleIndex);
+
+  // Moves the beat clock forward; call before reading the phase
+  void advanceTo(uint64_t sampleIndex);
+
+  float bpm() const { return locked ? 60.0f * rate / period : 0; }
+  float confidence() const { return lastConfidence; }
+
+  // Position within the current beat at `sampleIndex` (0..1) and beats so far
+  float beatPhase(uint64_t sampleIndex) const;
+  uint32_t beatNumber() const { return beats; }
+
+  uint32_t hopCount() const { return hops; }
+  uint32_t totalCycles() const { return cycles; }
+
+private:
+  void finishSweep(uint64_t hopEnd);
+
+  float sampleRate = 0;
+  float rate = 0;              // Envelope values per second
+  uint32_t hop = 0;
+  int minLag = 0;
+  int maxLag = 0;
+
+  float envelope[TEMPO_ENVELOPE_LEN] = {0};
+  int head = 0;                // Next slot to write
+  int filled = 0;
+  float envelopeSum = 0;
+
+  float acf[TEMPO_ENVELOPE_LEN / 2] = {0};
+  int nextLag = 0;
+  float lastConfidence = 0;
+
+  bool locked = false;
+  float period = 0;            // Beat period in envelope hops
+  double lastBeat = 0;         // Sample index of the most recent beat
+  double nextBeat = 0;
+  uint32_t beats = 0;
+
+  volatile uint32_t hops = 0;
+  volatile uint32_t cycles = 0;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+
+// ===============================
+// EVENT TRACE
+// ===============================
+// Build with -D LIGHTSHOW_TRACE to record a timeline of the last
+// TRACE_EVENTS events in RAM: the profiler's stage probes as begin/end
+// pairs plus instant marks for things like dropped frames, each with a
+// cycle timestamp and the core it ran on. Any task records without locks:
+// an atomic increment claims the next slot and the oldest event is
+// overwritten.
+//
+// 't' on the console asks for a dump. The log task writes it, so only the
+// task that already waits on the UART waits on it, and recording pauses
+// while it runs. tools/trace_to_chrome.cpp turns the dump into JSON for
+// chrome://tracing or ui.perfetto.dev. Dump lines:
+//   trace-begin <cycles per us> <events>
+//   trace-name <id> <name>
+//   trace <B|E|I> <id> <core> <cycles, hex>
+//   trace-end
+// Without the flag the probes compile to nothing.
+
+// Event ids below TRACE_MARK_BASE are profiler stages (see profiler.h)
+#define TRACE_MARK_BASE 64
+
+enum TraceMark {
+  TRACE_ONSET = TRACE_MARK_BASE,  // An onset reached the render task
+  TRACE_FRAME_DROPPED,            // Capture queue full, a block was lost
+  TRACE_CAPTURE_OVERFLOW,         // The I2S DMA ring overran
+  TRACE_LED_WAIT,                 // show() had to wait for the previous frame
+  TRACE_EFFECT_DOWNGRADE,         // The effect engine dropped quality or a frame
+  TRACE_MARK_END
+};
+
+#ifdef LIGHTSHOW_TRACE
+
+#include "hal.h"
+
+struct TraceEvent {
+  uint32_t cycles;
+  uint16_t id;
+  char type;  // 'B'egin, 'E'nd or 'I'nstant
+  uint8_t core;
+};
+
+void traceEventAt(char type, uint16_t id, uint32_t cycles);
+
+inline void traceEvent(char type, uint16_t id) {
+  traceEventAt(type, id, hal::clock().cycles());
+}
+
+void traceRequestDump();
+
+// Writes a requested dump; called from the log task
+void traceService();
+
+// Writes the buffer now and starts over
+void traceDump();
+
+class TraceScope {
+public:
+  explicit TraceScope(uint16_t id) : id(id) { traceEvent('B', id); }
+  ~TraceScope() { traceEvent('E', id); }
+
+private:
+  uint16_t id;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(id) TraceScope TRACE_CONCAT(traceScope, __LINE__)(id)
+#define TRACE_SPAN(id, start, end) (traceEventAt('B', id, start), traceEventAt('E', id, end))
+#define TRACE_MARK(id) traceEvent('I', id)
+#define TRACE_SERVICE() traceService()
+
+#else
+
+#define TRACE_SCOPE(id) ((void)0)
+#define TRACE_SPAN(id, start, end) ((void)0)
+#define TRACE_MARK(id) ((void)0)
+#define TRACE_SERVICE() ((void)0)
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+// ===============================
+// CENTER-OUT VU LAYOUT
+// ===============================
+// The VU lights LEDs alternately right and left of the center, colored by
+// distance from it. Both depend only on the LED count, so they are worked
+// out at compile time and rendering a bar of n LEDs is a walk over the
+// first n entries.
+template <int Count>
+struct VuLayout {
+  uint16_t order[Count];  // Strip index of the i-th LED to light
+  uint32_t color[Count];  // Its color, 0x00RRGGBB
+};
+
+template <int Count>
+constexpr VuLayout<Count> makeVuLayout() {
+  VuLayout<Count> layout = {};
+  int center = Count / 2;
+  for (int i = 0; i < Count; i++) {
+    // Even steps go right from center, odd ones left
+    int ledIndex = (i % 2 == 0) ? center + i / 2 : center - 1 - i / 2;
+
+    // Same float math as the old per-frame code so thresholds land alike
+    int offset = ledIndex > center ? ledIndex - center : center - ledIndex;
+    float distanceFromCenter = offset / (float)(Count / 2);
+    layout.order[i] = ledIndex;
+    layout.color[i] = (distanceFromCenter < 0.33) ? 0x00FF00 :   // green (center)
+                      (distanceFromCenter < 0.66) ? 0xFFFF00 :   // yellow (middle)
+                                                     0xFF0000;    // red (edges)
+  }
+  return layout;
+}
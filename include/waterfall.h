@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "hal.h"
+
+// ===============================
+// SPECTROGRAM WATERFALL
+// ===============================
+// Band intensities scroll down a matrix, newest row at the top. History is
+// a ring of rows: scrolling advances the ring's head instead of moving the
+// stored rows, so adding a row costs one row whatever the height. Rows are
+// pushed on their own clock, independent of the FFT hop rate; in between,
+// each band keeps the loudest value it saw.
+#define WATERFALL_MAX_BANDS 16
+
+// Black through blue, magenta, red and yellow to white
+constexpr uint32_t heatColor(int level) {
+  return level < 64 ? (uint32_t)(level * 255 / 63) :                                 // to blue
+         level < 128 ? ((uint32_t)((level - 64) * 255 / 63) << 16) | 0xFF :          // to magenta
+         level < 192 ? 0xFF0000 | (uint32_t)(255 - (level - 128) * 255 / 63) :       // to red
+         level < 224 ? 0xFF0000 | ((uint32_t)((level - 192) * 255 / 31) << 8) :      // to yellow
+                       0xFFFF00 | (uint32_t)((level - 224) * 255 / 31);              // to white
+}
+
+struct HeatPalette {
+  uint32_t color[256];
+};
+
+constexpr HeatPalette makeHeatPalette() {
+  HeatPalette palette = {};
+  for (int i = 0; i < 256; i++) {
+    palette.color[i] = heatColor(i);
+  }
+  return palette;
+}
+
+template <typename Canvas, int Bands>
+class Waterfall {
+  static_assert(Bands <= WATERFALL_MAX_BANDS, "Too many waterfall bands");
+
+public:
+  // Folds one set of band levels (0..1) into the row being collected
+  void addBands(const float* levels) {
+    for (int band = 0; band < Bands; band++) {
+      float level = levels[band] < 0 ? 0 : (levels[band] > 1 ? 1 : levels[band]);
+      uint8_t value = (uint8_t)(level * 255 + 0.5f);
+      if (value > pending[band]) {
+        pending[band] = value;
+      }
+    }
+  }
+
+  // Pushes the collected row every rowMs. Returns true when it scrolled.
+  bool tick(uint32_t now, uint32_t rowMs) {
+    if (now - lastRow < rowMs) {
+      return false;
+    }
+    lastRow = now;
+    head = head + 1 < Canvas::height ? head + 1 : 0;
+    memcpy(rows[head], pending, sizeof(pending));
+    memset(pending, 0, sizeof(pending));
+    return true;
+  }
+
+  // Draws the whole history, reading the ring from its head downwards
+  template <typename Target>
+  void draw(Target& leds) const {
+    int row = head;
+    for (int y = 0; y < Canvas::height; y++) {
+      const uint8_t* levels = rows[row];
+      for (int x = 0; x < Canvas::width; x++) {
+        Canvas::setPixel(leds, x, y, palette.color[levels[columnBand(x)]]);
+      }
+      row = row > 0 ? row - 1 : Canvas::height - 1;
+    }
+  }
+
+  void clear() {
+    memset(rows, 0, sizeof(rows));
+    memset(pending, 0, sizeof(pending));
+  }
+
+private:
+  // Bass on the left, as in the band zones
+  static constexpr int columnBand(int x) { return x * Bands / Canvas::width; }
+
+  static constexpr HeatPalette palette = makeHeatPalette();
+
+  uint8_t rows[Canvas::height][Bands] = {};  // Ring of band intensities
+  uint8_t pending[Bands] = {};
+  int head = 0;
+  uint32_t lastRow = 0;
+};
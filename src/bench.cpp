@@ -0,0 +1,428 @@
+#ifdef LIGHTSHOW_BENCH
+
+#include <stdio.h>
+
+#include "platform.h"
+
+#include "bench.h"
+#include "color.h"
+#include "config.h"
+#include "dither.h"
+#include "goertzel.h"
+#include "hal.h"
+#include "rms.h"
+#include "spectrum.h"
+#include "telemetry.h"
+#include "vu_layout.h"
+
+#define BENCH_ITERATIONS 2000
+
+// Deterministic test signal generator (xorshift32)
+static uint32_t benchRandomState = 0x12345678;
+static uint32_t benchRandom() {
+  benchRandomState ^= benchRandomState << 13;
+  benchRandomState ^= benchRandomState >> 17;
+  benchRandomState ^= benchRandomState << 5;
+  return benchRandomState;
+}
+
+// Fills a block with raw I2S words whose shifted value is a sine of the
+// given amplitude plus optional uniform noise
+static void fillBlock(int32_t* block, size_t count, float amplitude, float frequency, int32_t noise) {
+  for (size_t i = 0; i < count; i++) {
+    float value = amplitude * sinf(2.0f * (float)M_PI * frequency * i / SAMPLE_RATE);
+    if (noise > 0) {
+      value += (int32_t)(benchRandom() % (2 * noise + 1)) - noise;
+    }
+    block[i] = (int32_t)value * (1 << SAMPLE_SHIFT);
+  }
+}
+
+// The pre-kernel capture loop, kept verbatim for comparison
+static float rmsFloatLoop(const int32_t* block, size_t count) {
+  float sum = 0;
+  int validSamples = 0;
+  for (size_t i = 0; i < count; ++i) {
+    int32_t sample = block[i] >> SAMPLE_SHIFT;
+    if (abs(sample) < SPIKE_LIMIT) {
+      sum += (sample * sample);
+      validSamples++;
+    }
+  }
+  return validSamples > 0 ? sqrt(sum / validSamples) : 0;
+}
+
+static double rmsDoubleReference(const int32_t* block, size_t count) {
+  double sum = 0;
+  int validSamples = 0;
+  for (size_t i = 0; i < count; ++i) {
+    int64_t sample = block[i] >> SAMPLE_SHIFT;
+    if (llabs(sample) < SPIKE_LIMIT) {
+      sum += (double)sample * (double)sample;
+      validSamples++;
+    }
+  }
+  return validSamples > 0 ? sqrt(sum / validSamples) : 0;
+}
+
+static void benchRmsAccuracy() {
+  struct Case { const char* name; float amplitude; float frequency; int32_t noise; };
+  const Case cases[] = {
+    {"silence", 0, 0, 0},
+    {"noise floor", 0, 0, 40},
+    {"quiet 1 kHz", 500, 1000, 20},
+    {"loud 100 Hz", 30000, 100, 200},
+    {"above int32 square", 60000, 440, 500},
+    {"near spike limit", 95000, 3000, 2000},
+  };
+
+  int32_t block[BUFFER_LEN];
+  hal::log().printf("RMS accuracy vs double reference (max abs error over 100 blocks):\n");
+  for (const Case& c : cases) {
+    double maxKernelError = 0;
+    double maxFloatError = 0;
+    for (int run = 0; run < 100; run++) {
+      fillBlock(block, BUFFER_LEN, c.amplitude, c.frequency + run, c.noise);
+      double reference = rmsDoubleReference(block, BUFFER_LEN);
+      double kernel = rmsQ31(block, BUFFER_LEN, SAMPLE_SHIFT, SPIKE_LIMIT).rms;
+      double legacy = rmsFloatLoop(block, BUFFER_LEN);
+      maxKernelError = max(maxKernelError, fabs(kernel - reference));
+      maxFloatError = max(maxFloatError, fabs(legacy - reference));
+    }
+    hal::log().printf("  %-20s kernel %10.3f   float loop %10.3f\n", c.name, maxKernelError, maxFloatError);
+  }
+}
+
+// Host (x86-64, g++ -O2) measures the kernel at ~80-120 ns per block against
+// ~45-85 ns for the float loop: the host squares in vector registers and has
+// a one-instruction sqrt, where the kernel pays for isqrt64(). The kernel is
+// on the hot path for the accuracy table above - the float loop is off by
+// tens of thousands once samples square past INT32_MAX - not for speed.
+// Only the board's cycle counter says what it costs on the ESP32.
+static void benchRmsCycles() {
+  int32_t block[BUFFER_LEN];
+  fillBlock(block, BUFFER_LEN, 20000, 440, 100);
+
+  volatile uint32_t sink = 0;
+  uint32_t start = hal::clock().cycles();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    sink += rmsQ31(block, BUFFER_LEN, SAMPLE_SHIFT, SPIKE_LIMIT).rms;
+  }
+  uint32_t kernelCycles = (hal::clock().cycles() - start) / BENCH_ITERATIONS;
+
+  volatile float floatSink = 0;
+  start = hal::clock().cycles();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    floatSink += rmsFloatLoop(block, BUFFER_LEN);
+  }
+  uint32_t floatCycles = (hal::clock().cycles() - start) / BENCH_ITERATIONS;
+
+  hal::log().printf("RMS cycles per %d-sample block (ns on the host): kernel %u, float loop %u\n",
+                    BUFFER_LEN, (unsigned)kernelCycles, (unsigned)floatCycles);
+#ifndef ARDUINO
+  hal::log().printf("  (host timings only; take ESP32 cycles from the LIGHTSHOW_BENCH build on the board)\n");
+#endif
+}
+
+// Cycles per block for a Goertzel bank of N bands fused into the RMS pass
+template <size_t N>
+static uint32_t goertzelCyclesPerBlock(const int32_t* signal, int blocks) {
+  static GoertzelBank<N> bank;
+  float frequencies[N];
+  for (size_t b = 0; b < N; b++) {
+    frequencies[b] = SPECTRUM_MIN_HZ * powf((float)SPECTRUM_MAX_HZ / SPECTRUM_MIN_HZ, (b + 0.5f) / N);
+  }
+  bank.begin(frequencies, SAMPLE_RATE, GOERTZEL_WINDOW);
+
+  volatile uint32_t sink = 0;
+  uint32_t start = hal::clock().cycles();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    sink += bank.process(signal + (i % blocks) * BUFFER_LEN, BUFFER_LEN, SAMPLE_SHIFT, SPIKE_LIMIT).rms;
+  }
+  return (hal::clock().cycles() - start) / BENCH_ITERATIONS;
+}
+
+static void benchGoertzelVsFft() {
+  const int blocks = FFT_SIZE / BUFFER_LEN;
+  static int32_t signal[FFT_SIZE];
+  for (int i = 0; i < blocks; i++) {
+    fillBlock(signal + i * BUFFER_LEN, BUFFER_LEN, 8000, 250 + 40 * i, 300);
+  }
+
+  // Baseline: the RMS pass on its own
+  volatile uint32_t sink = 0;
+  uint32_t start = hal::clock().cycles();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    sink += rmsQ31(signal + (i % blocks) * BUFFER_LEN, BUFFER_LEN, SAMPLE_SHIFT, SPIKE_LIMIT).rms;
+  }
+  uint32_t rmsCycles = (hal::clock().cycles() - start) / BENCH_ITERATIONS;
+
+  // FFT cost amortized over the blocks that feed it, plus the same RMS pass
+  static SpectrumAnalyzer analyzer;
+  analyzer.begin(SAMPLE_RATE);
+  start = hal::clock().cycles();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    const int32_t* block = signal + (i % blocks) * BUFFER_LEN;
+    analyzer.addSamples(block, BUFFER_LEN, SAMPLE_SHIFT);
+    sink += rmsQ31(block, BUFFER_LEN, SAMPLE_SHIFT, SPIKE_LIMIT).rms;
+  }
+  uint32_t fftCycles = (hal::clock().cycles() - start) / BENCH_ITERATIONS;
+
+  hal::log().printf("Band analysis cycles per %d-sample block, including RMS (ns on the host):\n", BUFFER_LEN);
+  hal::log().printf("  RMS only                %8u\n", (unsigned)rmsCycles);
+  hal::log().printf("  Goertzel x%-2d            %8u\n", GOERTZEL_BANDS, (unsigned)goertzelCyclesPerBlock<GOERTZEL_BANDS>(signal, blocks));
+  hal::log().printf("  Goertzel x%-2d            %8u\n", SPECTRUM_BANDS, (unsigned)goertzelCyclesPerBlock<SPECTRUM_BANDS>(signal, blocks));
+  hal::log().printf("  FFT %d/%d, %2d bands    %8u\n", FFT_SIZE, FFT_HOP, SPECTRUM_BANDS, (unsigned)fftCycles);
+}
+
+// The per-LED VU code from before the layout tables, kept for comparison
+template <int Count>
+static void renderVuComputed(uint32_t* pixels, int lit) {
+  int center = Count / 2;
+  for (int i = 0; i < lit; i++) {
+    int ledIndex;
+    if (i % 2 == 0) {
+      ledIndex = center + (i / 2);
+    } else {
+      ledIndex = center - 1 - (i / 2);
+    }
+    if (ledIndex >= 0 && ledIndex < Count) {
+      float distanceFromCenter = abs(ledIndex - center) / (float)(Count / 2);
+      uint32_t color = (distanceFromCenter < 0.33) ? 0x00FF00 :
+                       (distanceFromCenter < 0.66) ? 0xFFFF00 :
+                                                      0xFF0000;
+      pixels[ledIndex] = color;
+    }
+  }
+}
+
+template <int Count>
+static void renderVuTable(uint32_t* pixels, int lit) {
+  static constexpr VuLayout<Count> layout = makeVuLayout<Count>();
+  for (int i = 0; i < lit; i++) {
+    pixels[layout.order[i]] = layout.color[i];
+  }
+}
+
+// Cycles to draw a full bar both ways, plus a check that they agree
+template <int Count>
+static void benchVuRenderAt() {
+  static uint32_t computed[Count];
+  static uint32_t table[Count];
+  const int iterations = BENCH_ITERATIONS / 10;
+
+  uint32_t start = hal::clock().cycles();
+  for (int i = 0; i < iterations; i++) {
+    renderVuComputed<Count>(computed, Count);
+  }
+  uint32_t computedCycles = (hal::clock().cycles() - start) / iterations;
+
+  start = hal::clock().cycles();
+  for (int i = 0; i < iterations; i++) {
+    renderVuTable<Count>(table, Count);
+  }
+  uint32_t tableCycles = (hal::clock().cycles() - start) / iterations;
+
+  bool same = memcmp(computed, table, sizeof(table)) == 0;
+  hal::log().printf("  %5d %10u %10u %s\n", Count, (unsigned)computedCycles, (unsigned)tableCycles,
+                    same ? "" : "MISMATCH");
+}
+
+static void benchVuRender() {
+  hal::log().printf("VU render cycles per full-bar frame (ns on the host):\n");
+  hal::log().printf("  %5s %10s %10s\n", "LEDs", "computed", "table");
+  benchVuRenderAt<60>();
+  benchVuRenderAt<150>();
+  benchVuRenderAt<300>();
+  benchVuRenderAt<600>();
+  benchVuRenderAt<1000>();
+}
+
+// Output cost of the 16-bit framebuffer at 1000 LEDs, and how closely the
+// average of 256 output frames tracks the 16-bit value
+static void benchDither() {
+  const int leds = 1000;
+  static uint16_t pixels[leds * 3];
+  static uint8_t out[leds * 3];
+  static uint8_t error[leds * 3];
+  for (int i = 0; i < leds * 3; i++) {
+    pixels[i] = benchRandom() & 0xFFFF;
+  }
+  const int iterations = BENCH_ITERATIONS / 10;
+
+  volatile uint32_t sink = 0;
+  uint32_t start = hal::clock().cycles();
+  for (int i = 0; i < iterations; i++) {
+    sink += ditherFrame(pixels, out, error, leds * 3);
+  }
+  uint32_t ditherCycles = (hal::clock().cycles() - start) / iterations;
+
+  start = hal::clock().cycles();
+  for (int i = 0; i < iterations; i++) {
+    truncateFrame(pixels, out, leds * 3);
+  }
+  uint32_t truncateCycles = (hal::clock().cycles() - start) / iterations;
+
+  // Every 16-bit level on one channel
+  uint32_t maxDitherError = 0;
+  uint32_t maxTruncateError = 0;
+  for (uint32_t level = 0; level < 0xFF00; level++) {
+    uint16_t in = level;
+    uint8_t shown;
+    uint8_t carried = 0;
+    uint32_t sum = 0;
+    for (int frame = 0; frame < 256; frame++) {
+      ditherFrame(&in, &shown, &carried, 1);
+      sum += shown;
+    }
+    truncateFrame(&in, &shown, 1);
+    maxDitherError = max(maxDitherError, (uint32_t)abs((int32_t)sum - (int32_t)level));
+    maxTruncateError = max(maxTruncateError, (uint32_t)abs((int32_t)shown * 256 - (int32_t)level));
+  }
+
+  hal::log().printf("16-bit to 8-bit output per %d-LED frame (ns on the host): dither %u, truncate %u\n",
+                    leds, (unsigned)ditherCycles, (unsigned)truncateCycles);
+  hal::log().printf("  Worst 256-frame average error in 16-bit steps: dither %u, truncate %u\n",
+                    (unsigned)maxDitherError, (unsigned)maxTruncateError);
+}
+
+// Per-channel versions of the packed color operations, for comparison
+static uint32_t naiveScale(uint32_t color, uint32_t scale) {
+  uint32_t r = (((color >> 16) & 0xFF) * scale) >> 8;
+  uint32_t g = (((color >> 8) & 0xFF) * scale) >> 8;
+  uint32_t b = ((color & 0xFF) * scale) >> 8;
+  return (r << 16) | (g << 8) | b;
+}
+
+static uint32_t naiveAddSaturate(uint32_t a, uint32_t x) {
+  uint32_t r = min(((a >> 16) & 0xFF) + ((x >> 16) & 0xFF), (uint32_t)255);
+  uint32_t g = min(((a >> 8) & 0xFF) + ((x >> 8) & 0xFF), (uint32_t)255);
+  uint32_t b = min((a & 0xFF) + (x & 0xFF), (uint32_t)255);
+  return (r << 16) | (g << 8) | b;
+}
+
+static uint32_t naiveLerp(uint32_t a, uint32_t x, uint32_t t) {
+  uint32_t r = (((a >> 16) & 0xFF) * (256 - t) + ((x >> 16) & 0xFF) * t) >> 8;
+  uint32_t g = (((a >> 8) & 0xFF) * (256 - t) + ((x >> 8) & 0xFF) * t) >> 8;
+  uint32_t b = ((a & 0xFF) * (256 - t) + (x & 0xFF) * t) >> 8;
+  return (r << 16) | (g << 8) | b;
+}
+
+#define COLOR_BENCH_PIXELS 1000
+
+// Runs one operation over a frame of pixels, returns cycles per frame
+template <typename Op>
+static uint32_t colorCyclesPerFrame(uint32_t* out, const uint32_t* a, const uint32_t* b, Op op) {
+  const int iterations = BENCH_ITERATIONS / 10;
+  uint32_t start = hal::clock().cycles();
+  for (int i = 0; i < iterations; i++) {
+    uint32_t t = i & 0xFF;
+    for (int p = 0; p < COLOR_BENCH_PIXELS; p++) {
+      out[p] = op(a[p], b[p], t);
+    }
+  }
+  return (hal::clock().cycles() - start) / iterations;
+}
+
+template <typename Naive, typename Packed>
+static void benchColorOp(const char* name, const uint32_t* a, const uint32_t* b, Naive naive, Packed packed) {
+  static uint32_t naiveOut[COLOR_BENCH_PIXELS];
+  static uint32_t packedOut[COLOR_BENCH_PIXELS];
+  uint32_t naiveCycles = colorCyclesPerFrame(naiveOut, a, b, naive);
+  uint32_t packedCycles = colorCyclesPerFrame(packedOut, a, b, packed);
+
+  // Exhaustive over t on the test pixels
+  bool same = true;
+  for (uint32_t t = 0; t <= 256 && same; t++) {
+    for (int p = 0; p < COLOR_BENCH_PIXELS; p++) {
+      if (naive(a[p], b[p], t) != packed(a[p], b[p], t)) {
+        same = false;
+        break;
+      }
+    }
+  }
+  hal::log().printf("  %-14s %10u %10u %s\n", name, (unsigned)naiveCycles, (unsigned)packedCycles,
+                    same ? "" : "MISMATCH");
+}
+
+static void benchColorMath() {
+  static uint32_t a[COLOR_BENCH_PIXELS];
+  static uint32_t b[COLOR_BENCH_PIXELS];
+  for (int p = 0; p < COLOR_BENCH_PIXELS; p++) {
+    a[p] = benchRandom() & 0xFFFFFF;
+    b[p] = benchRandom() & 0xFFFFFF;
+  }
+
+  hal::log().printf("Color math cycles per %d-pixel frame (ns on the host):\n", COLOR_BENCH_PIXELS);
+  hal::log().printf("  %-14s %10s %10s\n", "", "per channel", "packed");
+  benchColorOp("scale", a, b,
+               [](uint32_t x, uint32_t, uint32_t t) { return naiveScale(x, t); },
+               [](uint32_t x, uint32_t, uint32_t t) { return colorScale(x, t); });
+  benchColorOp("add saturate", a, b,
+               [](uint32_t x, uint32_t y, uint32_t) { return naiveAddSaturate(x, y); },
+               [](uint32_t x, uint32_t y, uint32_t) { return colorAddSaturate(x, y); });
+  benchColorOp("lerp", a, b,
+               [](uint32_t x, uint32_t y, uint32_t t) { return naiveLerp(x, y, t); },
+               [](uint32_t x, uint32_t y, uint32_t t) { return colorLerp(x, y, t); });
+  benchColorOp("fade to black", a, b,
+               [](uint32_t x, uint32_t, uint32_t t) { return naiveScale(x, 256 - t); },
+               [](uint32_t x, uint32_t, uint32_t t) { return colorFadeToBlack(x, t); });
+}
+
+// Per-frame cost of the binary telemetry against formatting the old
+// plotter line (formatting only; the UART time scales with the bytes)
+static void benchTelemetry() {
+  const int iterations = BENCH_ITERATIONS;
+  char line[128];
+  uint8_t frame[TELEMETRY_FRAME_MAX];
+  float volume = 1234.56f;
+
+  volatile uint32_t sink = 0;
+  int textBytes = 0;
+  uint32_t start = hal::clock().cycles();
+  for (int i = 0; i < iterations; i++) {
+    textBytes = snprintf(line, sizeof(line), "MinRange:%d,Volume:%.2f,SmoothVolume:%.2f,SmoothPeak:%.2f,MaxRange:%d\n",
+                         -1000, volume + i, volume, 2999.5f, 4000);
+    sink += line[textBytes - 2];
+  }
+  uint32_t textCycles = (hal::clock().cycles() - start) / iterations;
+
+  size_t binaryBytes = 0;
+  start = hal::clock().cycles();
+  for (int i = 0; i < iterations; i++) {
+    TelemetrySample sample = {(uint16_t)i, (uint32_t)i * 5, volume + i, volume, 2999.5f};
+    binaryBytes = telemetryEncode(sample, frame);
+    sink += frame[binaryBytes - 2];
+  }
+  uint32_t binaryCycles = (hal::clock().cycles() - start) / iterations;
+
+  // Round trip over the fixed-point range
+  bool roundTrip = true;
+  for (int i = 0; i < 65536 && roundTrip; i += 7) {
+    TelemetrySample sample = {(uint16_t)i, (uint32_t)i * 1000003u, i / 10.0f, (65535 - i) / 10.0f, i / 20.0f};
+    TelemetrySample decoded;
+    size_t length = telemetryEncode(sample, frame);
+    roundTrip = telemetryDecode(frame + 1, length - 2, decoded) && decoded.sequence == sample.sequence &&
+                decoded.timeMs == sample.timeMs && fabsf(decoded.volume - sample.volume) < 0.06f &&
+                fabsf(decoded.smoothVolume - sample.smoothVolume) < 0.06f &&
+                fabsf(decoded.smoothPeak - sample.smoothPeak) < 0.06f;
+  }
+
+  hal::log().printf("Telemetry per frame (ns on the host): text %u cycles / %d bytes, binary %u cycles / %u bytes%s\n",
+                    (unsigned)textCycles, textBytes, (unsigned)binaryCycles, (unsigned)binaryBytes,
+                    roundTrip ? "" : " ROUND TRIP MISMATCH");
+}
+
+void runBenchmarks() {
+  hal::log().printf("=== Benchmarks ===\n");
+  benchRmsAccuracy();
+  benchRmsCycles();
+  benchGoertzelVsFft();
+  benchVuRender();
+  benchDither();
+  benchColorMath();
+  benchTelemetry();
+  hal::log().printf("=== Benchmarks done ===\n");
+}
+
+#endif
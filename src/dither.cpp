@@ -0,0 +1,24 @@
+#include "dither.h"
+
+// 0xFF00 is already full on: clamping there means value + error never
+// needs more than 16 bits and the output never saturates
+#define DITHER_FULL_SCALE 0xFF00u
+
+bool ditherFrame(const uint16_t* in, uint8_t* out, uint8_t* error, size_t channels) {
+  uint32_t fractions = 0;
+  for (size_t i = 0; i < channels; i++) {
+    uint32_t target = in[i] < DITHER_FULL_SCALE ? in[i] : DITHER_FULL_SCALE;
+    uint32_t value = target + error[i];
+    out[i] = value >> 8;
+    error[i] = value & 0xFF;
+    fractions |= target & 0xFF;
+  }
+  return fractions != 0;
+}
+
+void truncateFrame(const uint16_t* in, uint8_t* out, size_t channels) {
+  for (size_t i = 0; i < channels; i++) {
+    uint32_t value = (in[i] < DITHER_FULL_SCALE ? in[i] : DITHER_FULL_SCALE) + 0x80;
+    out[i] = value >> 8;
+  }
+}
@@ -0,0 +1,532 @@
+#include "platform.h"
+
+#include "color.h"
+#include "effects.h"
+#include "level_curve.h"
+#include "log.h"
+#include "matrix.h"
+#include "profiler.h"
+#include "vu_layout.h"
+#include "waterfall.h"
+
+// ===============================
+// ENGINE
+// ===============================
+bool EffectEngine::add(Effect* effect) {
+  if (effectCount >= EFFECT_MAX) {
+    return false;
+  }
+  effects[effectCount++] = effect;
+  return true;
+}
+
+void EffectEngine::select(int index) {
+  if (index < 0 || index >= effectCount) {
+    return;
+  }
+  active = index;
+  qualityLevel = 0;
+  overruns = 0;
+  comfortableFrames = 0;
+  skipNext = false;
+  frame.clear();
+  current().begin();
+}
+
+bool EffectEngine::select(const char* name) {
+  for (int i = 0; i < effectCount; i++) {
+    if (strcmp(effects[i]->name(), name) == 0) {
+      select(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+void EffectEngine::next() {
+  select((active + 1) % effectCount);
+}
+
+void EffectEngine::renderFrame(const AudioFeatures& features, LedSink& leds, uint32_t frameMicros) {
+  if (effectCount == 0) {
+    return;
+  }
+  if (skipNext) {
+    // The LEDs hold the last frame
+    skipNext = false;
+    window.skipped++;
+    return;
+  }
+
+  Clock& clock = hal::clock();
+  uint32_t cyclesPerMicro = clock.cyclesPerMicrosecond();
+  uint32_t start = clock.cycles();
+  current().render(features, frame, qualityLevel);
+  uint32_t rendered = clock.cycles();
+
+  // Only changed pixels go to the sink, which skips unchanged frames itself.
+  // They go at full precision so the sink can dither the fraction.
+  const Color16* pixels = frame.data();
+  for (int i = 0; i < LED_COUNT; i++) {
+    if (pixels[i] != shown[i]) {
+      shown[i] = pixels[i];
+      leds.setPixel16(i, color16Red(pixels[i]), color16Green(pixels[i]), color16Blue(pixels[i]));
+    }
+  }
+  leds.show();
+  uint32_t done = clock.cycles();
+
+  PROFILE_SPAN(STAGE_EFFECT, start, rendered);
+  PROFILE_SPAN(STAGE_LED_SHOW, rendered, done);
+
+  uint32_t renderMicros = (rendered - start) / cyclesPerMicro;
+  uint32_t output = (done - rendered) / cyclesPerMicro;
+  outputMicros += 0.1f * (output - outputMicros);
+  uint32_t budget = frameMicros > outputMicros ? frameMicros - (uint32_t)outputMicros : 0;
+
+  window.frames++;
+  windowRenderMicros += renderMicros;
+  windowOutputMicros += output;
+  window.maxRenderMicros = max(window.maxRenderMicros, renderMicros);
+  window.budgetMicros = budget;
+
+  adaptQuality(renderMicros, budget);
+}
+
+void EffectEngine::adaptQuality(uint32_t renderMicros, uint32_t budgetMicros) {
+  if (renderMicros > budgetMicros) {
+    comfortableFrames = 0;
+    if (++overruns < EFFECT_OVERRUNS_TO_DOWNGRADE) {
+      return;
+    }
+    if (qualityLevel + 1 < current().qualityLevels()) {
+      qualityLevel++;
+      overruns = 0;
+      window.downgrades++;
+      TRACE_MARK(TRACE_EFFECT_DOWNGRADE);
+      LOG_WARN("Effect %s over budget (%u of %u us), quality %d\n", current().name(),
+               (unsigned)renderMicros, (unsigned)budgetMicros, qualityLevel);
+    } else {
+      skipNext = true;  // Nothing cheaper left: skip frames while it overruns
+      TRACE_MARK(TRACE_EFFECT_DOWNGRADE);
+    }
+    return;
+  }
+
+  overruns = 0;
+  if (renderMicros < budgetMicros * EFFECT_UPGRADE_HEADROOM) {
+    if (++comfortableFrames >= EFFECT_UPGRADE_FRAMES && qualityLevel > 0) {
+      qualityLevel--;
+      comfortableFrames = 0;
+    }
+  } else {
+    comfortableFrames = 0;
+  }
+}
+
+EffectStats EffectEngine::takeStats() {
+  EffectStats stats = window;
+  if (window.frames > 0) {
+    stats.renderMicros = windowRenderMicros / window.frames;
+    stats.outputMicros = windowOutputMicros / window.frames;
+  }
+  window = {};
+  windowRenderMicros = 0;
+  windowOutputMicros = 0;
+  return stats;
+}
+
+int EffectEngine::litPixels() const {
+  int lit = 0;
+  for (int i = 0; i < LED_COUNT; i++) {
+    lit += shown[i] != 0;
+  }
+  return lit;
+}
+
+// ===============================
+// SHARED LAYOUT
+// ===============================
+// On a matrix, bars run bottom to top and a bar step is a whole row
+#if LED_MATRIX
+typedef MatrixCanvas<MATRIX_WIDTH, MATRIX_HEIGHT, MATRIX_WIRING> Canvas;
+#define VU_STEPS MATRIX_HEIGHT
+#define ZONE_SPAN MATRIX_WIDTH   // Spectrum zones split the columns
+
+// Row colors from the bottom up, same thresholds as the strip's gradient
+static uint32_t vuRowColor(int step) {
+  float height = step / (float)VU_STEPS;
+  return (height < 0.33) ? 0x00FF00 : (height < 0.66) ? 0xFFFF00 : 0xFF0000;
+}
+
+// One step of the VU: the step-th row from the bottom across every column
+static void setVuStep(FrameBuffer& frame, int step, bool lit) {
+  uint32_t color = lit ? vuRowColor(step) : 0;
+  for (int x = 0; x < Canvas::width; x++) {
+    Canvas::setPixel(frame, x, Canvas::height - 1 - step, color);
+  }
+}
+
+// One step of a spectrum zone: a row of the zone's columns
+static void setZoneStep(FrameBuffer& frame, int zoneStart, int zoneEnd, int step, uint32_t color) {
+  for (int x = zoneStart; x < zoneEnd; x++) {
+    Canvas::setPixel(frame, x, Canvas::height - 1 - step, color);
+  }
+}
+#else
+#define VU_STEPS LED_COUNT
+#define ZONE_SPAN LED_COUNT
+
+static constexpr VuLayout<LED_COUNT> vuLayout = makeVuLayout<LED_COUNT>();
+
+// One step of the VU: the next LED out from the center
+static void setVuStep(FrameBuffer& frame, int step, bool lit) {
+  frame.setPixel(vuLayout.order[step], lit ? vuLayout.color[step] : 0);
+}
+
+// One step of a spectrum zone: the next LED from its left edge
+static void setZoneStep(FrameBuffer& frame, int zoneStart, int, int step, uint32_t color) {
+  frame.setPixel(zoneStart + step, color);
+}
+#endif
+
+// Deterministic pseudo-random numbers for the effects (xorshift32)
+static uint32_t effectRandomState = 0x2545F491;
+static uint32_t effectRandom() {
+  effectRandomState ^= effectRandomState << 13;
+  effectRandomState ^= effectRandomState >> 17;
+  effectRandomState ^= effectRandomState << 5;
+  return effectRandomState;
+}
+
+// ===============================
+// VU
+// ===============================
+// Center-out bar (vertical bars on a matrix). Only the LEDs between last
+// frame's bar and this frame's are rewritten. 'm' cycles the mapping curve.
+class VuEffect : public Effect {
+public:
+  VuEffect() { mapper.begin(VU_CURVE, MIN_VOLUME, VU_STEPS); }
+
+  const char* name() const override { return "vu"; }
+  void begin() override { litLeds = 0; }
+
+  void render(const AudioFeatures& features, FrameBuffer& frame, int) override {
+    // Map volume to LED count using actual smoothed volume peak
+    mapper.setPeak(features.volumePeak);
+    int numLedsToLight = mapper.ledsFor(features.level);
+
+    // Grow or shrink the bar from where it was
+    for (int i = litLeds; i < numLedsToLight; i++) {
+      setVuStep(frame, i, true);
+    }
+    for (int i = numLedsToLight; i < litLeds; i++) {
+      setVuStep(frame, i, false);
+    }
+    litLeds = numLedsToLight;
+  }
+
+  bool command(int key) override {
+    if (key != 'm') {
+      return false;
+    }
+    mapper.setCurve((VuCurve)((mapper.curve() + 1) % CURVE_COUNT));
+    LOG_INFO("VU curve: %s\n", LevelMapper::curveName(mapper.curve()));
+    return true;
+  }
+
+private:
+  LevelMapper mapper;
+  int litLeds = 0;  // VU bar length last frame
+};
+
+// ===============================
+// SPECTRUM ZONES
+// ===============================
+// One zone per band, bass on the left, each filled from its left edge
+// (from the bottom on a matrix), redrawn only where it changed
+class SpectrumEffect : public Effect {
+public:
+  const char* name() const override { return "spectrum"; }
+
+  void begin() override {
+    for (int band = 0; band < SPECTRUM_BANDS; band++) {
+      zoneLit[band] = 0;
+    }
+  }
+
+  void render(const AudioFeatures& features, FrameBuffer& frame, int) override {
+    for (int band = 0; band < SPECTRUM_BANDS; band++) {
+      int zoneStart = band * ZONE_SPAN / SPECTRUM_BANDS;
+      int zoneEnd = (band + 1) * ZONE_SPAN / SPECTRUM_BANDS;
+#if LED_MATRIX
+      int zoneSteps = MATRIX_HEIGHT;
+#else
+      int zoneSteps = zoneEnd - zoneStart;
+#endif
+
+      // Same silence gate as the VU so the zones do not dance on noise
+      int lit = features.silent ? 0 : (int)(features.bands[band] * zoneSteps + 0.5f);
+
+      int previous = zoneLit[band];
+      uint32_t color = colorWheel(band * 200 / SPECTRUM_BANDS);
+      for (int i = previous; i < lit; i++) {
+        setZoneStep(frame, zoneStart, zoneEnd, i, color);
+      }
+      for (int i = lit; i < previous; i++) {
+        setZoneStep(frame, zoneStart, zoneEnd, i, 0);
+      }
+      zoneLit[band] = lit;
+    }
+  }
+
+private:
+  int zoneLit[SPECTRUM_BANDS] = {0};
+};
+
+#if LED_MATRIX
+// ===============================
+// SPECTROGRAM WATERFALL (matrix only)
+// ===============================
+// Repainted only when a row scrolls in; the frames between stay unchanged
+class WaterfallEffect : public Effect {
+public:
+  const char* name() const override { return "waterfall"; }
+  void begin() override { waterfall.clear(); }
+
+  void render(const AudioFeatures& features, FrameBuffer& frame, int quality) override {
+    if (!features.silent) {
+      waterfall.addBands(features.bands);
+    }
+    if (waterfall.tick(features.now, WATERFALL_ROW_MS)) {
+      waterfall.draw(frame);
+    }
+  }
+
+private:
+  Waterfall<Canvas, SPECTRUM_BANDS> waterfall;
+};
+#endif
+
+// ===============================
+// PULSE
+// ===============================
+// The whole strip in one color mixed from the Goertzel bands (kick and
+// bass red, mid and presence green, air blue; the FFT bands split in thirds
+// without them), brightness following the level and a white flash on every
+// onset. With a tempo lock it also swells on every beat of the musical
+// clock and flashes on each bar's downbeat, even where the onset detector
+// heard nothing. Quality 0 shapes it into a glow around the center.
+#define PULSE_FLASH_DECAY 0.8f     // Per-frame fall of the onset flash
+#define PULSE_BEAT_FLOOR 0.5f      // Brightness just before the next beat, of the level's
+#define PULSE_DOWNBEAT_FLASH 0.6f  // Flash at the start of a bar
+
+class PulseEffect : public Effect {
+public:
+  const char* name() const override { return "pulse"; }
+  int qualityLevels() const override { return 2; }
+  void begin() override {
+    flash = 0;
+    lastBarPhase = 0;
+  }
+
+  void render(const AudioFeatures& features, FrameBuffer& frame, int quality) override {
+    if (features.beat) {
+      flash = 1.0f;
+    }
+    float beatGlow = 1.0f;
+    if (features.bpm > 0) {
+      if (features.barPhase < lastBarPhase) {
+        flash = max(flash, PULSE_DOWNBEAT_FLASH);  // The bar wrapped: downbeat
+      }
+      // Full at the beat, easing down to the floor before the next one
+      float fall = features.beatPhase * features.beatPhase;
+      beatGlow = 1.0f - (1.0f - PULSE_BEAT_FLOOR) * fall;
+    }
+    lastBarPhase = features.barPhase;
+
+    Color16 color = 0;
+    if (!features.silent && features.volumePeak > 0) {
+      float mix[3] = {0, 0, 0};
+#if GOERTZEL_ENABLED
+      // Loudest band per channel, so a kick alone turns the strip red
+      for (int band = 0; band < GOERTZEL_BANDS; band++) {
+        float& channel = mix[band * 3 / GOERTZEL_BANDS];
+        channel = max(channel, features.goertzelBands[band]);
+      }
+#else
+      const int third = SPECTRUM_BANDS / 3;
+      for (int band = 0; band < SPECTRUM_BANDS; band++) {
+        mix[min(band / third, 2)] += features.bands[band] / third;
+      }
+#endif
+      // Brightness goes in before quantizing, so quiet passages fade
+      // smoothly instead of in 8-bit steps
+      float brightness = constrain(features.level / features.volumePeak, 0.0f, 1.0f) * beatGlow;
+      float full = brightness * 0xFF00;
+      color = color16((uint16_t)(mix[0] * full), (uint16_t)(mix[1] * full), (uint16_t)(mix[2] * full));
+      color = color16Lerp(color, COLOR16_WHITE, (uint32_t)(flash * 128));
+    }
+    flash *= PULSE_FLASH_DECAY;
+
+    Color16* pixels = frame.data();
+    if (quality == 0) {
+      // Linear falloff from the center to a quarter at the ends
+      const int center = LED_COUNT / 2;
+      for (int i = 0; i < LED_COUNT; i++) {
+        uint32_t distance = abs(i - center);
+        pixels[i] = color16Scale(color, 256 - distance * 192 / (center + 1));
+      }
+    } else {
+      for (int i = 0; i < LED_COUNT; i++) {
+        pixels[i] = color;
+      }
+    }
+  }
+
+private:
+  float flash = 0;
+  float lastBarPhase = 0;
+};
+
+// ===============================
+// RIPPLES
+// ===============================
+// Every onset starts a ring from a random spot, colored by the loudest
+// band, that spreads out and fades while the whole strip decays and blurs.
+// Cost grows with the strip, so quality trades ripples, anti-aliasing and
+// blur passes: {8, smooth, 2 passes}, {4, smooth, 1 pass}, {2, hard, none}.
+#define RIPPLE_MAX 8
+#define RIPPLE_SPEED 0.4f      // Strip lengths per second
+#define RIPPLE_LIFETIME 1500   // Milliseconds to fade out
+#define RIPPLE_FADE 24         // Per-frame fade of the trail (of 256)
+
+class RippleEffect : public Effect {
+public:
+  const char* name() const override { return "ripple"; }
+  int qualityLevels() const override { return 3; }
+
+  void begin() override {
+    rippleCount = 0;
+    lastFrame = 0;
+  }
+
+  void render(const AudioFeatures& features, FrameBuffer& frame, int quality) override {
+    static const int maxRipples[] = {RIPPLE_MAX, RIPPLE_MAX / 2, RIPPLE_MAX / 4};
+    static const int blurPasses[] = {2, 1, 0};
+
+    uint32_t elapsed = lastFrame == 0 ? 0 : features.now - lastFrame;
+    lastFrame = features.now;
+
+    if (features.beat && !features.silent) {
+      spawn(features, maxRipples[quality]);
+    }
+
+    // At 16 bits the trail fades out smoothly instead of in 8-bit steps
+    Color16* pixels = frame.data();
+    fadeToBlack16(pixels, LED_COUNT, RIPPLE_FADE);
+
+    // Advance, retire and draw the ripples. After a quality drop only the
+    // newest fit, the ones that just answered an onset.
+    float step = RIPPLE_SPEED * LED_COUNT * elapsed / 1000.0f;
+    int kept = 0;
+    for (int r = max(0, rippleCount - maxRipples[quality]); r < rippleCount; r++) {
+      Ripple ripple = ripples[r];
+      ripple.radius += step;
+      ripple.age += elapsed;
+      if (ripple.age >= RIPPLE_LIFETIME || ripple.radius > LED_COUNT) {
+        continue;
+      }
+      Color16 color = color16Scale(ripple.color, 256 - ripple.age * 256 / RIPPLE_LIFETIME);
+      drawFront(pixels, ripple.center + ripple.radius, color, quality < 2);
+      drawFront(pixels, ripple.center - ripple.radius, color, quality < 2);
+      ripples[kept++] = ripple;
+    }
+    rippleCount = kept;
+
+    for (int pass = 0; pass < blurPasses[quality]; pass++) {
+      blur(pixels);
+    }
+  }
+
+private:
+  struct Ripple {
+    float center;
+    float radius;
+    uint32_t age;  // Milliseconds
+    Color16 color;
+  };
+
+  void spawn(const AudioFeatures& features, int limit) {
+    if (rippleCount >= limit) {
+      // Replace the oldest
+      for (int r = 1; r < rippleCount; r++) {
+        ripples[r - 1] = ripples[r];
+      }
+      rippleCount--;
+    }
+    int loudest = 0;
+    for (int band = 1; band < SPECTRUM_BANDS; band++) {
+      if (features.bands[band] > features.bands[loudest]) {
+        loudest = band;
+      }
+    }
+    Ripple& ripple = ripples[rippleCount++];
+    ripple.center = effectRandom() % LED_COUNT;
+    ripple.radius = 0;
+    ripple.age = 0;
+    ripple.color = color16(colorWheel(loudest * 200 / SPECTRUM_BANDS));
+  }
+
+  // Adds a ring front at a fractional position, split over two pixels
+  static void drawFront(Color16* pixels, float position, Color16 color, bool smooth) {
+    if (position < 0 || position >= LED_COUNT - 1) {
+      return;
+    }
+    int index = (int)position;
+    if (!smooth) {
+      pixels[index] = color16AddSaturate(pixels[index], color);
+      return;
+    }
+    uint32_t fraction = (uint32_t)((position - index) * 256);
+    pixels[index] = color16AddSaturate(pixels[index], color16Scale(color, 256 - fraction));
+    pixels[index + 1] = color16AddSaturate(pixels[index + 1], color16Scale(color, fraction));
+  }
+
+  // Pulls every pixel a third of the way towards its neighbours' average
+  static void blur(Color16* pixels) {
+    const Color16 halvable = 0xFFFEFFFEFFFEull;  // Low bit of each channel cleared
+    Color16 previous = pixels[0];
+    for (int i = 1; i < LED_COUNT - 1; i++) {
+      Color16 current = pixels[i];
+      Color16 neighbours = ((previous & halvable) >> 1) + ((pixels[i + 1] & halvable) >> 1);
+      pixels[i] = color16Lerp(current, neighbours, 85);
+      previous = current;
+    }
+  }
+
+  Ripple ripples[RIPPLE_MAX];
+  int rippleCount = 0;
+  uint32_t lastFrame = 0;
+};
+
+// ===============================
+// REGISTRY
+// ===============================
+static VuEffect vuEffect;
+static SpectrumEffect spectrumEffect;
+#if LED_MATRIX
+static WaterfallEffect waterfallEffect;
+#endif
+static PulseEffect pulseEffect;
+static RippleEffect rippleEffect;
+
+void registerEffects(EffectEngine& engine) {
+  engine.add(&vuEffect);
+  engine.add(&spectrumEffect);
+#if LED_MATRIX
+  engine.add(&waterfallEffect);
+#endif
+  engine.add(&pulseEffect);
+  engine.add(&rippleEffect);
+}
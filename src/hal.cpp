@@ -0,0 +1,19 @@
+#include <stdio.h>
+
+#include "hal.h"
+
+void Log::printf(const char* format, ...) {
+  char line[LOG_LINE_MAX];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+
+  if (length < 0) {
+    return;
+  }
+  if (length >= (int)sizeof(line)) {
+    length = sizeof(line) - 1;  // Truncated
+  }
+  write(line, length);
+}
@@ -0,0 +1,469 @@
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <driver/i2s.h>
+#include <driver/rmt.h>
+
+#include "config.h"
+#include "dirty_range.h"
+#include "dither.h"
+#include "hal.h"
+#include "log.h"
+#include "trace.h"
+
+// ===============================
+// I2S MICROPHONE
+// ===============================
+class I2sAudioSource : public AudioSource {
+public:
+  bool begin() override {
+    LOG_INFO("Initializing I2S for SPH0645 microphone...\n");
+    if (!install() || !setPins()) {
+      return false;
+    }
+
+    esp_err_t err = i2s_start(I2S_PORT);
+    if (err != ESP_OK) {
+      LOG_ERROR("I2S start failed: %d\n", err);
+      return false;
+    }
+    // Sample 0 is the first one clocked in after the start. Buffers from
+    // before it don't belong to that timeline.
+    startMicros = micros();
+    clockRate = i2s_get_clk(I2S_PORT);
+    drain();
+    LOG_INFO("I2S started successfully\n");
+    return true;
+  }
+
+  bool waitForBlocks(CaptureBatch& batch) override {
+    batch.readyBlocks = 0;
+    batch.overflows = 0;
+    batch.droppedSamples = 0;
+
+    // Sleep until the driver reports a completed DMA buffer
+    i2s_event_t event;
+    if (xQueueReceive(eventQueue, &event, portMAX_DELAY) != pdTRUE) {
+      return true;
+    }
+
+    // Collect every event that is already pending into one batch
+    do {
+      if (event.type == I2S_EVENT_RX_DONE) {
+        batch.readyBlocks++;
+      } else if (event.type == I2S_EVENT_RX_Q_OVF) {
+        // The driver discarded its oldest unread buffer to make room
+        batch.overflows++;
+        batch.droppedSamples += BUFFER_LEN;
+      }
+    } while (xQueueReceive(eventQueue, &event, 0) == pdTRUE);
+    return true;
+  }
+
+  size_t readBlock(int32_t* dst, size_t maxSamples) override {
+    size_t bytesIn = 0;
+    esp_err_t result = i2s_read(I2S_PORT, dst, maxSamples * sizeof(int32_t), &bytesIn, 0);
+    if (result != ESP_OK) {
+      return 0;
+    }
+    return bytesIn / sizeof(int32_t);
+  }
+
+  uint32_t discardPending() override {
+    // Buffers the driver dropped on overflow still count
+    uint32_t discarded = 0;
+    i2s_event_t event;
+    while (xQueueReceive(eventQueue, &event, 0) == pdTRUE) {
+      if (event.type == I2S_EVENT_RX_Q_OVF) {
+        discarded += BUFFER_LEN;
+      }
+    }
+    // The buffers themselves wait in the driver's DMA queue, not in the
+    // events; left there, every later read would return the oldest one
+    return discarded + drain();
+  }
+
+  uint32_t sampleMicros(uint64_t index) override {
+    return startMicros + (uint32_t)((double)index * 1000000.0 / clockRate);
+  }
+
+  bool sampleTimesModeled() override { return false; }
+
+private:
+  // Reads the DMA queue empty, returns the samples thrown away
+  uint32_t drain() {
+    uint32_t discarded = 0;
+    size_t bytesIn;
+    while (i2s_read(I2S_PORT, discardBuffer, sizeof(discardBuffer), &bytesIn, 0) == ESP_OK && bytesIn > 0) {
+      discarded += bytesIn / sizeof(int32_t);
+    }
+    return discarded;
+  }
+
+  bool install() {
+    const i2s_config_t i2s_config = {
+      .mode = i2s_mode_t(I2S_MODE_MASTER | I2S_MODE_RX),
+      .sample_rate = SAMPLE_RATE,
+      .bits_per_sample = I2S_BITS_PER_SAMPLE_32BIT,
+      .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
+      .communication_format = I2S_COMM_FORMAT_STAND_I2S,  // Changed from I2S_COMM_FORMAT_I2S
+      .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+      .dma_buf_count = DMA_BUF_COUNT,
+      .dma_buf_len = BUFFER_LEN,
+      .use_apll = false,
+      .tx_desc_auto_clear = false,
+      .fixed_mclk = 0
+    };
+
+    esp_err_t err = i2s_driver_install(I2S_PORT, &i2s_config, I2S_EVENT_QUEUE_LEN, &eventQueue);
+    if (err != ESP_OK) {
+      LOG_ERROR("I2S driver install failed: %d\n", err);
+      return false;
+    }
+    LOG_INFO("I2S driver installed successfully\n");
+    return true;
+  }
+
+  bool setPins() {
+    const i2s_pin_config_t pin_config = {
+      .bck_io_num = I2S_SCK,
+      .ws_io_num = I2S_WS,
+      .data_out_num = -1,
+      .data_in_num = I2S_SD
+    };
+
+    esp_err_t err = i2s_set_pin(I2S_PORT, &pin_config);
+    if (err != ESP_OK) {
+      LOG_ERROR("I2S pin config failed: %d\n", err);
+      return false;
+    }
+    LOG_INFO("I2S pins configured successfully\n");
+    return true;
+  }
+
+  QueueHandle_t eventQueue = NULL;
+  int32_t discardBuffer[BUFFER_LEN];
+  uint32_t startMicros = 0;       // When sample 0 was clocked in
+  float clockRate = SAMPLE_RATE;  // Actual rate the I2S clock divides down to
+};
+
+// ===============================
+// CLOCK
+// ===============================
+class EspClock : public Clock {
+public:
+  uint32_t millis() override { return ::millis(); }
+  uint32_t micros() override { return ::micros(); }
+  uint32_t cycles() override { return ESP.getCycleCount(); }
+  uint32_t cyclesPerMicrosecond() override { return ESP.getCpuFreqMHz(); }
+  void delay(uint32_t ms) override { ::delay(ms); }
+};
+
+// ===============================
+// WS2812 STRIPS (RMT)
+// ===============================
+// Pixels are drawn into a 16-bit GRB framebuffer. show() reduces it to 8
+// bits (dithered, see dither.h) into one of two wire buffers and hands that
+// to the RMT peripheral, whose interrupt expands it into WS2812 bit timings
+// while the render task draws the next frame. show() only blocks when the
+// previous frame is still streaming, and skips frames that would not change
+// the strip. Only the span drawn since the last frame and pixels still
+// dithering are reduced and compared, the rest is copied from the wire.
+//
+// A pixel between 8-bit steps would change every frame and keep the strip
+// busy forever. An unchanged pixel therefore stops dithering once its
+// error pattern has repeated: within LED_DITHER_SETTLE frames, every
+// pattern has gone through a full cycle. It then holds its nearest 8-bit
+// step until it is drawn again, so a still picture settles and its frames
+// are skipped. Fades and anything else still moving keep the full dither. The RMT end-of-transmission interrupt timestamps each strip,
+// so the reported wire time is measured: from the writes to the last strip
+// finishing, plus the latch the strips need afterwards.
+#define WS2812_CLK_DIV 2                  // 80 MHz APB / 2 = 25 ns ticks
+#define WS2812_T0H 16                     // 0.40 us
+#define WS2812_T0L 34                     // 0.85 us
+#define WS2812_T1H 32                     // 0.80 us
+#define WS2812_T1L 18                     // 0.45 us
+
+static void IRAM_ATTR ws2812Translate(const void* src, rmt_item32_t* dest, size_t srcSize,
+                                      size_t wantedItems, size_t* translatedSize, size_t* itemCount) {
+  rmt_item32_t bit0;
+  bit0.level0 = 1;
+  bit0.duration0 = WS2812_T0H;
+  bit0.level1 = 0;
+  bit0.duration1 = WS2812_T0L;
+  rmt_item32_t bit1;
+  bit1.level0 = 1;
+  bit1.duration0 = WS2812_T1H;
+  bit1.level1 = 0;
+  bit1.duration1 = WS2812_T1L;
+
+  const uint8_t* bytes = (const uint8_t*)src;
+  size_t size = 0;
+  size_t items = 0;
+  while (size < srcSize && items + 8 <= wantedItems) {
+    for (int bit = 7; bit >= 0; bit--) {
+      dest[items++].val = (bytes[size] >> bit) & 1 ? bit1.val : bit0.val;
+    }
+    size++;
+  }
+  *translatedSize = size;
+  *itemCount = items;
+}
+
+// The 8 RMT channels share 8 memory blocks
+#define LED_RMT_CHANNELS 8
+#define LED_BLOCKS_PER_STRIP (LED_STRIPS * LED_RMT_MEM_BLOCKS <= LED_RMT_CHANNELS ? LED_RMT_MEM_BLOCKS : 1)
+#define LED_STRIP_BYTES (LED_STRIP_LENGTH * 3)
+static_assert(LED_STRIPS >= 1 && LED_STRIPS <= LED_RMT_CHANNELS, "LED_STRIPS must be 1 to 8");
+
+class RmtLedSink : public LedSink {
+public:
+  void begin() override {
+    const int pins[] = LED_STRIP_PINS;
+    static_assert(sizeof(pins) / sizeof(pins[0]) == LED_STRIPS, "LED_STRIP_PINS needs one pin per strip");
+
+    for (int strip = 0; strip < LED_STRIPS; strip++) {
+      rmt_channel_t channel = stripChannel(strip);
+      rmt_config_t config = RMT_DEFAULT_CONFIG_TX((gpio_num_t)pins[strip], channel);
+      config.clk_div = WS2812_CLK_DIV;
+      config.mem_block_num = LED_BLOCKS_PER_STRIP;
+      esp_err_t err = rmt_config(&config);
+      if (err == ESP_OK) {
+        err = rmt_driver_install(channel, 0, 0);
+      }
+      if (err == ESP_OK) {
+        err = rmt_translator_init(channel, ws2812Translate);
+      }
+      if (err != ESP_OK) {
+        LOG_ERROR("LED RMT init failed for strip %d: %d\n", strip, err);
+        return;
+      }
+    }
+    rmt_register_tx_end_callback(txDone, this);
+    ready = true;
+
+    // Start from dark strips
+    clear();
+    show();
+  }
+
+  void clear() override {
+    for (uint16_t i = 0; i < LED_COUNT; i++) {
+      writePixel(i, 0, 0, 0);
+    }
+  }
+
+  void setPixel(uint16_t index, uint32_t color) override {
+    if (index >= LED_COUNT) {
+      return;
+    }
+    // 8-bit channel times BRIGHTNESS + 1 is the NeoPixel scaling before its
+    // final >> 8, so nothing is rounded away until output
+    writePixel(index, ((color >> 8) & 0xFF) * (BRIGHTNESS + 1),   // G
+               ((color >> 16) & 0xFF) * (BRIGHTNESS + 1),         // R
+               (color & 0xFF) * (BRIGHTNESS + 1));                // B
+  }
+
+  void setPixel16(uint16_t index, uint16_t r, uint16_t g, uint16_t b) override {
+    if (index >= LED_COUNT) {
+      return;
+    }
+    writePixel(index, scale16(g), scale16(r), scale16(b));
+  }
+
+  void show() override {
+    ledStats.frames++;
+    if (!ready) {
+      return;
+    }
+    // Nothing drawn and nothing left to dither: the strip already shows it
+    if (dirty.empty() && dithering.empty() && stripKnown) {
+      ledStats.skipped++;
+      return;
+    }
+
+    // Only drawn pixels and those still working off a remainder can change.
+    // The rest of the back buffer is caught up with the frame on the wire.
+    DirtyRange span = dirty;
+    span.include(dithering);
+    dirty.reset();
+    dithering.reset();
+    uint16_t first = span.empty() ? LED_COUNT : span.first();
+    uint16_t end = span.empty() ? LED_COUNT : span.end();
+    memcpy(frames[back], frames[back ^ 1], first * sizeof(frames[back][0]));
+    memcpy(frames[back][end], frames[back ^ 1][end], (LED_COUNT - end) * sizeof(frames[back][0]));
+    for (uint16_t i = first; i < end; i++) {
+#if LED_DITHER
+      if (ditherAge[i] >= LED_DITHER_SETTLE) {
+        truncateFrame(pixels[i], frames[back][i], 3);
+      } else if (ditherFrame(pixels[i], frames[back][i], ditherError[i], 3)) {
+        ditherAge[i]++;
+        dithering.mark(i);
+      }
+#else
+      truncateFrame(pixels[i], frames[back][i], 3);
+#endif
+    }
+    size_t spanBytes = (end - first) * sizeof(frames[back][0]);
+    if (stripKnown && memcmp(frames[back][first], frames[back ^ 1][first], spanBytes) == 0) {
+      ledStats.skipped++;
+      return;
+    }
+
+    // The front buffer belongs to the RMT until its frame is out and latched
+    uint32_t start = micros();
+    bool busy = false;
+    for (int strip = 0; strip < LED_STRIPS; strip++) {
+      if (rmt_wait_tx_done(stripChannel(strip), 0) != ESP_OK) {
+        busy = true;
+        rmt_wait_tx_done(stripChannel(strip), portMAX_DELAY);
+      }
+    }
+    collectTransfer();
+    while (micros() - doneAt < LED_LATCH_US) {
+      busy = true;  // Latch time left over when the frame only just finished
+    }
+    if (busy) {
+      TRACE_MARK(TRACE_LED_WAIT);
+      uint32_t waited = micros() - start;
+      ledStats.waits++;
+      ledStats.waitMicros += waited;
+      ledStats.maxWaitMicros = max(ledStats.maxWaitMicros, waited);
+    }
+
+    // Mirrored strips all read the same bytes, spanned ones their own slice
+    sentAt = micros();
+    stripsDone = 0;
+    measuring = true;
+    stripKnown = true;
+    for (int strip = 0; strip < LED_STRIPS; strip++) {
+      size_t offset = LED_LAYOUT == LED_LAYOUT_SPAN ? strip * LED_STRIP_BYTES : 0;
+      rmt_write_sample(stripChannel(strip), frames[back][0] + offset, LED_STRIP_BYTES, false);
+    }
+
+    back ^= 1;
+  }
+
+  void service() override { collectTransfer(); }
+  LedStats stats() override { return ledStats; }
+
+private:
+  static uint16_t scale16(uint32_t value) { return (value * (BRIGHTNESS + 1)) >> 8; }
+
+  // RMT interrupt: one strip has sent its last bit
+  static void IRAM_ATTR txDone(rmt_channel_t, void* arg) {
+    RmtLedSink* sink = (RmtLedSink*)arg;
+    sink->doneAt = micros();
+    sink->stripsDone++;
+  }
+
+  // Takes the wire time of the last frame once every strip has finished it
+  void collectTransfer() {
+    if (measuring && stripsDone >= LED_STRIPS) {
+      ledStats.transferMicros = doneAt - sentAt + LED_LATCH_US;
+      measuring = false;
+    }
+  }
+
+  // Channels with more than one memory block take over their neighbours'
+  static rmt_channel_t stripChannel(int strip) {
+    return (rmt_channel_t)(strip * LED_BLOCKS_PER_STRIP);
+  }
+
+  void writePixel(uint16_t index, uint16_t g, uint16_t r, uint16_t b) {
+    uint16_t* pixel = pixels[index];
+    if (pixel[0] != g || pixel[1] != r || pixel[2] != b) {
+      pixel[0] = g;
+      pixel[1] = r;
+      pixel[2] = b;
+      ditherAge[index] = 0;
+      dirty.mark(index);
+    }
+  }
+
+  uint16_t pixels[LED_COUNT][3] = {};     // What the renderers drew, GRB
+  uint8_t ditherError[LED_COUNT][3] = {};
+  DirtyRange dithering;                    // Pixels with a channel between 8-bit steps
+  uint16_t ditherAge[LED_COUNT] = {};      // Frames dithered since the pixel was drawn
+  uint8_t frames[2][LED_COUNT][3] = {};    // Wire buffers
+  int back = 0;
+  bool ready = false;
+  uint32_t sentAt = 0;
+  volatile uint32_t doneAt = 0;  // When the last strip finished (RMT interrupt)
+  volatile int stripsDone = 0;   // Strips finished since the last send
+  bool measuring = false;        // A frame is out and not yet timed
+  bool stripKnown = false;  // Nothing sent yet, the strips may show anything
+  DirtyRange dirty;
+  LedStats ledStats = {};
+};
+
+// ===============================
+// SERIAL LOG
+// ===============================
+class SerialLog : public Log {
+public:
+  void write(const char* text, size_t length) override {
+    Serial.write((const uint8_t*)text, length);
+  }
+
+  void writeFrame(const uint8_t* data, size_t length) override {
+    Serial.write(data, length);
+  }
+
+  int read() override {
+    return Serial.available() > 0 ? Serial.read() : -1;
+  }
+};
+
+// ===============================
+// NVS STORAGE
+// ===============================
+#define STORAGE_NAMESPACE "lightshow"
+#define STORAGE_KEY "state"
+
+class NvsStorage : public Storage {
+public:
+  bool load(void* data, size_t length) override {
+    if (!prefs.begin(STORAGE_NAMESPACE, true)) {
+      return false;  // Namespace does not exist until the first save
+    }
+    bool ok = prefs.getBytesLength(STORAGE_KEY) == length &&
+              prefs.getBytes(STORAGE_KEY, data, length) == length;
+    prefs.end();
+    return ok;
+  }
+
+  bool save(const void* data, size_t length) override {
+    if (!prefs.begin(STORAGE_NAMESPACE, false)) {
+      return false;
+    }
+    bool ok = prefs.putBytes(STORAGE_KEY, data, length) == length;
+    prefs.end();
+    return ok;
+  }
+
+private:
+  Preferences prefs;
+};
+
+static I2sAudioSource i2sAudio;
+static EspClock espClock;
+static RmtLedSink rmtLeds;
+static SerialLog serialLog;
+static NvsStorage nvsStorage;
+
+namespace hal {
+void begin() {
+  Serial.begin(115200);
+  delay(1000);
+}
+
+AudioSource& audio() { return i2sAudio; }
+Clock& clock() { return espClock; }
+LedSink& leds() { return rmtLeds; }
+Log& log() { return serialLog; }
+Storage& storage() { return nvsStorage; }
+}
+
+#endif
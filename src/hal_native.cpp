@@ -0,0 +1,450 @@
+#ifndef ARDUINO
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "dirty_range.h"
+#include "dither.h"
+#include "hal.h"
+#include "log.h"
+#include "profiler.h"
+
+void setup();
+void loop();
+
+// ===============================
+// WAV FILE INPUT
+// ===============================
+// Plays one or more PCM WAV files back to back. The first channel is
+// converted to the left-justified 32-bit words the I2S microphone delivers.
+class WavAudioSource : public AudioSource {
+public:
+  void addFile(const char* path) { paths.push_back(path); }
+  bool finished() const { return done; }
+  uint64_t samplesDelivered() const { return delivered; }
+
+  bool begin() override {
+    return openNext();
+  }
+
+  bool waitForBlocks(CaptureBatch& batch) override {
+    batch.readyBlocks = 0;
+    batch.overflows = 0;
+    batch.droppedSamples = 0;
+
+    while (file == NULL || remainingFrames == 0) {
+      if (!openNext()) {
+        done = true;
+        return false;
+      }
+    }
+    batch.readyBlocks = 1;
+    readyBlocks = 1;
+    return true;
+  }
+
+  size_t readBlock(int32_t* dst, size_t maxSamples) override {
+    // Only what the last wait made ready, like the DMA queue
+    if (file == NULL || readyBlocks == 0) {
+      return 0;
+    }
+    readyBlocks--;
+
+    size_t count = 0;
+    uint8_t frame[64];
+    while (count < maxSamples && remainingFrames > 0) {
+      if (fread(frame, frameBytes, 1, file) != 1) {
+        remainingFrames = 0;
+        break;
+      }
+      dst[count++] = decodeSample(frame);
+      remainingFrames--;
+    }
+    delivered += count;
+    return count;
+  }
+
+  uint32_t discardPending() override { return 0; }
+
+  // The replay clock (see NativeClock) is the sample position itself
+  uint32_t sampleMicros(uint64_t index) override { return (uint32_t)(index * 1000000 / SAMPLE_RATE); }
+  bool sampleTimesModeled() override { return true; }
+
+private:
+  bool openNext() {
+    if (file != NULL) {
+      fclose(file);
+      file = NULL;
+    }
+    while (nextPath < paths.size()) {
+      const char* path = paths[nextPath++].c_str();
+      file = fopen(path, "rb");
+      if (file == NULL) {
+        LOG_ERROR("Cannot open %s\n", path);
+        continue;
+      }
+      if (parseHeader()) {
+        LOG_INFO("Playing %s (%u Hz, %u-bit, %u ch, %u frames)\n", path,
+                 sampleRate, bitsPerSample, channels, remainingFrames);
+        if (sampleRate != SAMPLE_RATE) {
+          LOG_WARN("Warning: expected %d Hz, timing will be scaled\n", SAMPLE_RATE);
+        }
+        return true;
+      }
+      LOG_ERROR("Unsupported WAV file %s\n", path);
+      fclose(file);
+      file = NULL;
+    }
+    return false;
+  }
+
+  static uint32_t readLe(const uint8_t* bytes, int count) {
+    uint32_t value = 0;
+    for (int i = count - 1; i >= 0; i--) {
+      value = (value << 8) | bytes[i];
+    }
+    return value;
+  }
+
+  // Walks the RIFF chunks and leaves the file positioned at the sample data
+  bool parseHeader() {
+    uint8_t header[12];
+    if (fread(header, sizeof(header), 1, file) != 1 ||
+        memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+      return false;
+    }
+
+    bool haveFormat = false;
+    uint8_t chunk[8];
+    while (fread(chunk, sizeof(chunk), 1, file) == 1) {
+      uint32_t size = readLe(chunk + 4, 4);
+      if (memcmp(chunk, "fmt ", 4) == 0) {
+        uint8_t fmt[40] = {0};
+        size_t toRead = size < sizeof(fmt) ? size : sizeof(fmt);
+        if (size < 16 || fread(fmt, toRead, 1, file) != 1) {
+          return false;
+        }
+        fseek(file, (long)(size - toRead + (size & 1)), SEEK_CUR);
+
+        formatTag = readLe(fmt, 2);
+        channels = readLe(fmt + 2, 2);
+        sampleRate = readLe(fmt + 4, 4);
+        bitsPerSample = readLe(fmt + 14, 2);
+        if (formatTag == 0xFFFE && size >= 26) {
+          formatTag = readLe(fmt + 24, 2);  // WAVE_FORMAT_EXTENSIBLE sub-format
+        }
+        haveFormat = true;
+      } else if (memcmp(chunk, "data", 4) == 0) {
+        if (!haveFormat || channels == 0) {
+          return false;
+        }
+        bool pcm = formatTag == 1 && (bitsPerSample == 16 || bitsPerSample == 24 || bitsPerSample == 32);
+        bool ieee = formatTag == 3 && bitsPerSample == 32;
+        frameBytes = channels * (bitsPerSample / 8);
+        if (!(pcm || ieee) || frameBytes > 64) {
+          return false;
+        }
+        remainingFrames = size / frameBytes;
+        return true;
+      } else {
+        fseek(file, (long)(size + (size & 1)), SEEK_CUR);
+      }
+    }
+    return false;
+  }
+
+  int32_t decodeSample(const uint8_t* frame) const {
+    if (formatTag == 3) {
+      float value;
+      memcpy(&value, frame, sizeof(value));
+      if (value > 1.0f) value = 1.0f;
+      if (value < -1.0f) value = -1.0f;
+      return (int32_t)(value * 2147483647.0f);
+    }
+    // Left-justify integer PCM into a 32-bit word
+    uint32_t raw = readLe(frame, bitsPerSample / 8);
+    return (int32_t)(raw << (32 - bitsPerSample));
+  }
+
+  std::vector<std::string> paths;
+  size_t nextPath = 0;
+  FILE* file = NULL;
+  uint32_t formatTag = 0;
+  uint32_t channels = 0;
+  uint32_t sampleRate = 0;
+  uint32_t bitsPerSample = 0;
+  uint32_t frameBytes = 0;
+  uint32_t remainingFrames = 0;
+  int readyBlocks = 0;  // Blocks readBlock() may still return
+  uint64_t delivered = 0;
+  bool done = false;
+};
+
+// ===============================
+// CLOCK
+// ===============================
+// Time follows the audio being replayed, so runs are deterministic and as
+// fast as the host allows. cycles() is real time for profiling.
+class NativeClock : public Clock {
+public:
+  explicit NativeClock(const WavAudioSource& source) : source(source) {}
+
+  uint32_t millis() override { return (uint32_t)(source.samplesDelivered() * 1000 / SAMPLE_RATE); }
+  uint32_t micros() override { return (uint32_t)(source.samplesDelivered() * 1000000 / SAMPLE_RATE); }
+
+  uint32_t cycles() override {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+  }
+
+  uint32_t cyclesPerMicrosecond() override { return 1000; }
+
+  // Nothing to wait for: the next block is simply read from the file
+  void delay(uint32_t) override {}
+
+private:
+  const WavAudioSource& source;
+};
+
+// ===============================
+// LED FRAME FILE
+// ===============================
+// One line per changed frame: "<millis> RRGGBB RRGGBB ..."
+class FrameFileSink : public LedSink {
+public:
+  void setPath(const char* newPath) { path = newPath; }
+  uint32_t framesWritten() const { return frames; }
+
+  void begin() override {
+    // What parallel strips would take on the wire, for the frame rate report
+    ledStats.transferMicros = LED_STRIP_LENGTH * 3 * LED_BYTE_US + LED_LATCH_US;
+    ledStats.transferModeled = true;
+    file = fopen(path.c_str(), "w");
+    if (file == NULL) {
+      LOG_ERROR("Cannot write LED frames to %s\n", path.c_str());
+    }
+  }
+
+  void clear() override {
+    for (uint16_t i = 0; i < LED_COUNT; i++) {
+      writePixel(i, 0);
+    }
+  }
+
+  void setPixel(uint16_t index, uint32_t color) override {
+    if (index < LED_COUNT) {
+      writePixel(index, color & 0xFFFFFF);
+    }
+  }
+
+  // Frames are logged at 8 bits, rounded rather than dithered
+  void setPixel16(uint16_t index, uint16_t r, uint16_t g, uint16_t b) override {
+    if (index < LED_COUNT) {
+      uint16_t in[3] = {r, g, b};
+      uint8_t out[3];
+      truncateFrame(in, out, 3);
+      writePixel(index, ((uint32_t)out[0] << 16) | ((uint32_t)out[1] << 8) | out[2]);
+    }
+  }
+
+  // Like the strip, only frames that differ from the last one are written
+  void show() override {
+    ledStats.frames++;
+    bool changed = dirty.differs((const uint8_t*)pixels, (const uint8_t*)sent, sizeof(pixels[0]));
+    dirty.reset();
+    if (!changed && frames > 0) {
+      ledStats.skipped++;
+      return;
+    }
+    memcpy(sent, pixels, sizeof(sent));
+    frames++;
+    if (file == NULL) {
+      return;
+    }
+    fprintf(file, "%u", hal::clock().millis());
+    for (int i = 0; i < LED_COUNT; i++) {
+      fprintf(file, " %06X", pixels[i]);
+    }
+    fputc('\n', file);
+  }
+
+  void service() override {}
+  LedStats stats() override { return ledStats; }
+
+  void close() {
+    if (file != NULL) {
+      fclose(file);
+      file = NULL;
+    }
+  }
+
+private:
+  void writePixel(uint16_t index, uint32_t color) {
+    if (pixels[index] != color) {
+      pixels[index] = color;
+      dirty.mark(index);
+    }
+  }
+
+  std::string path = "led_frames.txt";
+  FILE* file = NULL;
+  uint32_t pixels[LED_COUNT] = {0};
+  uint32_t sent[LED_COUNT] = {0};  // Last frame written
+  uint32_t frames = 0;
+  DirtyRange dirty;
+  LedStats ledStats = {};  // No wire, so never any waiting
+};
+
+// ===============================
+// STDOUT LOG
+// ===============================
+class StdoutLog : public Log {
+public:
+  void write(const char* text, size_t length) override {
+    fwrite(text, 1, length, stdout);
+  }
+
+  // Telemetry goes to its own file when one was given, else nowhere
+  bool openTelemetry(const char* path) {
+    telemetry = fopen(path, "wb");
+    return telemetry != NULL;
+  }
+
+  void writeFrame(const uint8_t* data, size_t length) override {
+    if (telemetry != NULL) {
+      fwrite(data, 1, length, telemetry);
+    }
+  }
+
+  void close() {
+    if (telemetry != NULL) {
+      fclose(telemetry);
+      telemetry = NULL;
+    }
+  }
+
+  // Replays have no operator, but console keys can be given up front
+  // (e.g. 'l' for a latency probe). stdin stays free for piping.
+  void setInput(const char* keys) { input = keys; }
+
+  int read() override { return *input != '\0' ? (unsigned char)*input++ : -1; }
+
+private:
+  FILE* telemetry = NULL;
+  const char* input = "";
+};
+
+// ===============================
+// STATE FILE
+// ===============================
+// Stands in for NVS. Without a path nothing persists, so replays of the
+// same WAV stay reproducible.
+class FileStorage : public Storage {
+public:
+  void setPath(const char* newPath) { path = newPath; }
+
+  bool load(void* data, size_t length) override {
+    if (path.empty()) {
+      return false;
+    }
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+      return false;
+    }
+    bool ok = fread(data, 1, length, file) == length && fgetc(file) == EOF;
+    fclose(file);
+    return ok;
+  }
+
+  bool save(const void* data, size_t length) override {
+    if (path.empty()) {
+      return false;
+    }
+    // Write a sibling and rename it so a crash never leaves half a state
+    std::string temp = path + ".tmp";
+    FILE* file = fopen(temp.c_str(), "wb");
+    if (file == NULL) {
+      return false;
+    }
+    bool ok = fwrite(data, 1, length, file) == length;
+    ok = fclose(file) == 0 && ok;
+    return ok && rename(temp.c_str(), path.c_str()) == 0;
+  }
+
+private:
+  std::string path;
+};
+
+static WavAudioSource wavAudio;
+static NativeClock nativeClock(wavAudio);
+static FrameFileSink frameSink;
+static StdoutLog stdoutLog;
+static FileStorage fileStorage;
+
+namespace hal {
+void begin() {}
+
+AudioSource& audio() { return wavAudio; }
+Clock& clock() { return nativeClock; }
+LedSink& leds() { return frameSink; }
+Log& log() { return stdoutLog; }
+Storage& storage() { return fileStorage; }
+}
+
+// Unit tests bring their own main()
+#ifndef PIO_UNIT_TESTING
+int main(int argc, char** argv) {
+  int inputs = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      frameSink.setPath(argv[++i]);
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      fileStorage.setPath(argv[++i]);
+    } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+      stdoutLog.setInput(argv[++i]);
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      if (!stdoutLog.openTelemetry(argv[++i])) {
+        fprintf(stderr, "cannot write %s\n", argv[i]);
+        return 1;
+      }
+    } else {
+      wavAudio.addFile(argv[i]);
+      inputs++;
+    }
+  }
+  if (inputs == 0) {
+    fprintf(stderr, "usage: %s [-o led_frames.txt] [-s state.bin] [-t telemetry.bin] [-k keys] input.wav [more.wav ...]\n", argv[0]);
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  setup();
+  while (!wavAudio.finished()) {
+    loop();
+  }
+#ifdef LIGHTSHOW_PROFILE
+  profileDump();
+  logDrain();
+#endif
+#ifdef LIGHTSHOW_TRACE
+  traceDump();
+#endif
+  frameSink.close();
+  stdoutLog.close();
+
+  double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  double audioSeconds = (double)wavAudio.samplesDelivered() / SAMPLE_RATE;
+  hal::log().printf("Processed %.2f s of audio in %.3f s (%.1fx real time), %u LED frames (%u unchanged)\n",
+                    audioSeconds, wallSeconds, wallSeconds > 0 ? audioSeconds / wallSeconds : 0.0,
+                    frameSink.framesWritten(), (unsigned)frameSink.stats().skipped);
+  return 0;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,88 @@
+#include "latency.h"
+
+#include "log.h"
+
+static const char* const stageNames[LATENCY_STAGES] = {
+  "capture", "analysis", "queue", "smoothing", "frame wait", "render", "wire",
+};
+
+struct LatencySeries {
+  uint32_t probes;
+  uint32_t missed;
+  uint32_t minMicros;
+  uint32_t maxMicros;
+  uint64_t stageMicros[LATENCY_STAGES];
+  uint8_t modeled;  // Stages modeled in any probe
+};
+
+static LatencySeries series;
+static uint32_t noiseState = 2463534242u;  // xorshift32 seed
+
+static const char* modeledMark(uint8_t modeled, int stage) {
+  return (modeled & (1 << stage)) != 0 ? "*" : "";
+}
+
+void latencyFillBurst(int32_t* samples, int count, int32_t level, int shift) {
+  int32_t word = level << shift;
+  for (int i = 0; i < count; i++) {
+    noiseState ^= noiseState << 13;
+    noiseState ^= noiseState >> 17;
+    noiseState ^= noiseState << 5;
+    samples[i] = (noiseState & 1) ? word : -word;
+  }
+}
+
+void latencyBegin() {
+  series = {};
+  series.minMicros = UINT32_MAX;
+}
+
+void latencyRecord(const LatencyStamps& stamps) {
+  // Each stage runs from one stamp to the next, so they add up to the total
+  const uint32_t times[LATENCY_STAGES + 1] = {
+    stamps.captured, stamps.read, stamps.published, stamps.consumed,
+    stamps.triggered, stamps.rendered, stamps.shown, stamps.latched,
+  };
+  uint32_t stages[LATENCY_STAGES];
+  for (int stage = 0; stage < LATENCY_STAGES; stage++) {
+    stages[stage] = times[stage + 1] - times[stage];
+    series.stageMicros[stage] += stages[stage];
+  }
+  uint32_t total = stamps.latched - stamps.captured;
+  series.probes++;
+  series.minMicros = total < series.minMicros ? total : series.minMicros;
+  series.maxMicros = total > series.maxMicros ? total : series.maxMicros;
+  series.modeled |= stamps.modeled;
+
+  // Only capture and wire are ever modeled, see latency.h
+  LOG_INFO("Latency - Probe %u: %.2f ms = capture %.2f%s + analysis %.2f + queue %.2f + smoothing %.2f + "
+           "frame wait %.2f + render %.2f + wire %.2f%s%s\n",
+           (unsigned)series.probes, total / 1000.0f, stages[0] / 1000.0f,
+           modeledMark(stamps.modeled, LATENCY_CAPTURE), stages[1] / 1000.0f, stages[2] / 1000.0f,
+           stages[3] / 1000.0f, stages[4] / 1000.0f, stages[5] / 1000.0f, stages[6] / 1000.0f,
+           modeledMark(stamps.modeled, LATENCY_WIRE), stamps.modeled != 0 ? " (* modeled)" : "");
+}
+
+void latencyMissed() {
+  series.missed++;
+  LOG_WARN("Latency - LEDs did not react to the burst, try again in a quiet room\n");
+}
+
+void latencySummary() {
+  // On demand, so shown at every level
+  if (series.probes == 0) {
+    LOG_ERROR("Latency - No probe reached the LEDs (%u missed)\n", (unsigned)series.missed);
+    return;
+  }
+  uint64_t total = 0;
+  for (int stage = 0; stage < LATENCY_STAGES; stage++) {
+    total += series.stageMicros[stage];
+  }
+  LOG_ERROR("Latency (ms)  avg %.2f, min %.2f, max %.2f over %u probes (%u missed)%s\n",
+            total / 1000.0f / series.probes, series.minMicros / 1000.0f, series.maxMicros / 1000.0f,
+            (unsigned)series.probes, (unsigned)series.missed, series.modeled != 0 ? ", * modeled" : "");
+  for (int stage = 0; stage < LATENCY_STAGES; stage++) {
+    LOG_ERROR("  %-12s %8.2f%s\n", stageNames[stage], series.stageMicros[stage] / 1000.0f / series.probes,
+              modeledMark(series.modeled, stage));
+  }
+}
@@ -0,0 +1,69 @@
+#include <math.h>
+
+#include "level_curve.h"
+
+void LevelMapper::begin(VuCurve curve, float floorLevel, uint16_t leds) {
+  floor = floorLevel;
+  ledCount = leds;
+  peak = 0;
+  scaled = false;
+  setCurve(curve);
+}
+
+void LevelMapper::setCurve(VuCurve curve) {
+  current = curve < CURVE_COUNT ? curve : CURVE_POWER;
+  for (int i = 0; i < CURVE_TABLE_SIZE; i++) {
+    float x = i / (float)(CURVE_TABLE_SIZE - 1);
+    float lit = roundf(shape(current, x) * ledCount);
+    // Anything above the floor lights at least one LED
+    table[i] = (uint16_t)(lit < 1 ? 1 : (lit > ledCount ? ledCount : lit));
+  }
+  builds++;
+}
+
+const char* LevelMapper::curveName(VuCurve curve) {
+  switch (curve) {
+    case CURVE_POWER:
+      return "power";
+    case CURVE_DB:
+      return "dB";
+    case CURVE_S:
+      return "S-curve";
+    case CURVE_SOFT_KNEE:
+      return "soft knee";
+    default:
+      return "?";
+  }
+}
+
+void LevelMapper::setPeak(float newPeak) {
+  if (fabsf(newPeak - peak) <= CURVE_PEAK_CHANGE * peak) {
+    return;
+  }
+  peak = newPeak;
+  scaled = peak > floor;
+  if (scaled) {
+    indexScale = (CURVE_TABLE_SIZE - 1) / (peak - floor);
+    fullLevel = peak * CURVE_FULL_FRACTION;
+  }
+  peakUpdates++;
+}
+
+float LevelMapper::shape(VuCurve curve, float x) {
+  switch (curve) {
+    case CURVE_DB: {
+      if (x <= 0) {
+        return 0;
+      }
+      float y = 1.0f + 20.0f * log10f(x) / CURVE_DB_RANGE;
+      return y > 0 ? y : 0;
+    }
+    case CURVE_S:
+      return x * x * (3.0f - 2.0f * x);
+    case CURVE_SOFT_KNEE:
+      return (1.0f + CURVE_KNEE_RATIO) * x / (1.0f + CURVE_KNEE_RATIO * x);
+    case CURVE_POWER:
+    default:
+      return powf(x, CURVE_POWER_EXPONENT);
+  }
+}
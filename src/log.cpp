@@ -0,0 +1,116 @@
+#include "platform.h"
+
+#include <string.h>
+
+#include <atomic>
+
+#include "config.h"
+#include "hal.h"
+#include "log.h"
+#include "mpsc_ring.h"
+#include "profiler.h"
+
+static MpscRing<LogRecord, LOG_RING_LEN> logRing;
+static std::atomic<uint8_t> currentLevel{LOG_LEVEL};
+static std::atomic<uint32_t> droppedRecords{0};
+static bool deferred = false;
+static uint32_t reportedDrops = 0;  // Drain side only
+
+LogLevel logLevel() {
+  return (LogLevel)currentLevel.load(std::memory_order_relaxed);
+}
+
+void setLogLevel(LogLevel level) {
+  currentLevel.store(level, std::memory_order_relaxed);
+  // Posted as an error so it shows at every level, including the new one
+  LOG_ERROR("Log level: %s\n", logLevelName(level));
+}
+
+const char* logLevelName(LogLevel level) {
+  switch (level) {
+    case LOG_LEVEL_ERROR:
+      return "error";
+    case LOG_LEVEL_WARN:
+      return "warn";
+    case LOG_LEVEL_INFO:
+      return "info";
+    default:
+      return "debug";
+  }
+}
+
+void logDefer() {
+  deferred = true;
+}
+
+// A frame rides in the record's argument space: its length, then the bytes
+static int copyFrame(char* out, size_t, const char*, const LogArg* args) {
+  size_t length = args[0].u;
+  memcpy(out, &args[1], length);
+  return (int)length;
+}
+
+static void writeRecord(const LogRecord& record) {
+  PROFILE_SCOPE(STAGE_LOG);
+  char line[LOG_LINE_MAX];
+  int length = record.formatter(line, sizeof(line), record.format, record.args);
+  if (length < 0) {
+    return;
+  }
+  if (record.formatter == copyFrame) {
+    hal::log().writeFrame((const uint8_t*)line, length);
+    return;
+  }
+  if (length >= (int)sizeof(line)) {
+    length = sizeof(line) - 1;  // Truncated
+  }
+  hal::log().write(line, length);
+}
+
+void logSubmit(const LogRecord& record) {
+  if (!deferred) {
+    writeRecord(record);
+    return;
+  }
+  if (!logRing.push(record)) {
+    droppedRecords.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+bool logFrame(const uint8_t* data, size_t length) {
+  static_assert(LOG_FRAME_MAX < LOG_LINE_MAX, "A frame must fit the line buffer");
+  if (length > LOG_FRAME_MAX) {
+    return false;
+  }
+  LogRecord record;
+  record.format = NULL;
+  record.formatter = copyFrame;
+  record.args[0].u = length;
+  memcpy(&record.args[1], data, length);
+  if (!deferred) {
+    writeRecord(record);
+    return true;
+  }
+  return logRing.push(record);
+}
+
+int logDrain() {
+  int written = 0;
+  LogRecord record;
+  while (logRing.pop(record)) {
+    writeRecord(record);
+    written++;
+  }
+
+  // Say so in the stream itself, whatever the level
+  uint32_t dropped = droppedRecords.load(std::memory_order_relaxed);
+  if (dropped != reportedDrops) {
+    hal::log().printf("(%u log messages dropped)\n", (unsigned)(dropped - reportedDrops));
+    reportedDrops = dropped;
+  }
+  return written;
+}
+
+uint32_t logDropped() {
+  return droppedRecords.load(std::memory_order_relaxed);
+}
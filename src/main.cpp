@@ -1,42 +1,114 @@
-#include <Arduino.h>
-#include <WS2812FX.h>
-#include <driver/i2s.h>
+#include "platform.h"
 
-// ===============================
-// CONFIGURATION
-// ===============================
+#include "bench.h"
+#include "config.h"
+#include "effects.h"
+#include "goertzel.h"
+#include "hal.h"
+#include "latency.h"
+#include "log.h"
+#include "onset.h"
+#include "profiler.h"
+#include "rms.h"
+#include "spectrum.h"
+#include "spsc_ring.h"
+#include "telemetry.h"
+#include "tempo.h"
 
-// Microphone I2S pins
-#define I2S_WS 25    // LRCL / WS
-#define I2S_SD 33    // DOUT
-#define I2S_SCK 32   // BCLK / SCK
+// Task layout: capture on core 0, rendering on core 1. Log output shares
+// core 0 with capture, which spends most of its time waiting on I2S.
+#define AUDIO_TASK_CORE 0
+#define RENDER_TASK_CORE 1
+#define LOG_TASK_CORE 0
+#define AUDIO_TASK_PRIORITY 5
+#define RENDER_TASK_PRIORITY 2
+#define LOG_TASK_PRIORITY 1
+#define AUDIO_TASK_STACK 4096
+#define RENDER_TASK_STACK 4096
+#define LOG_TASK_STACK 4096
+#define LOG_IDLE_MS 10  // Log task sleep when the ring is empty
+#define FRAME_QUEUE_LEN 32  // Per-block features in flight (must be a power of two)
 
-// LED configuration
-#define LED_PIN     4
-#define LED_COUNT   60
-#define BRIGHTNESS  100
+// Per-block volume features handed from the audio task to the render task
+struct VolumeFrame {
+  uint64_t sampleIndex;    // Index of the block's first sample since capture start
+  float rms;               // Raw block RMS
+  float calibratedVolume;  // RMS minus baseline, noise gated
+  float rawVolume;         // Scaled volume before any smoothing
+  float volume;            // After moving average and delta limiter
+  float smoothVolume;      // After EMA smoothing
+  bool hasSpectrum;        // An FFT completed during this block
+  float bands[SPECTRUM_BANDS];  // Band energies in dB when hasSpectrum is set
+  float bandVolumes[GOERTZEL_BANDS];  // Smoothed Goertzel band volumes (latest window)
+  bool hasOnset;           // An onset was detected in this block
+  uint64_t onsetSample;    // Sample index of the transient when hasOnset is set
+  float onsetStrength;     // Flux over threshold when hasOnset is set
+  float baselineNoise;     // Noise floor in use for this block
+  int8_t calibrationResult;  // 1 calibration finished, -1 failed, 0 neither
+  float bpm;               // Tracked tempo, 0 until locked
+  float beatPhase;         // Position within the current beat at the block's end (0..1)
+  uint32_t beatNumber;     // Beats counted by the tempo tracker
+  bool latencyProbe;       // First block of a latency probe burst
+  uint32_t probeCaptured;  // Its latency stamps (micros) when latencyProbe is set
+  uint32_t probeRead;
+  uint32_t probePublished;
+};
 
-// Audio processing
-#define I2S_PORT I2S_NUM_0
-#define BUFFER_LEN 64
-#define MAX_VOLUME_TARGET 3000  // Target maximum volume
+SpscRing<VolumeFrame, FRAME_QUEUE_LEN> frameQueue;
+#if LIGHTSHOW_TASKS
+TaskHandle_t audioTaskHandle = NULL;
+TaskHandle_t renderTaskHandle = NULL;
+void audioTask(void* param);
+void renderTask(void* param);
+void logTask(void* param);
+#endif
 
+// Capture statistics (written by the audio task, read by the render task)
+std::atomic<uint32_t> capturedBlocks{0};
+std::atomic<uint32_t> droppedBlocks{0};     // Frame queue was full
+std::atomic<uint32_t> queueDepthMax{0};     // High-water mark of the frame queue
+std::atomic<uint32_t> captureOverflows{0};  // Input overflows (I2S_EVENT_RX_Q_OVF on the ESP32)
+std::atomic<uint32_t> droppedSamples{0};    // Samples lost to those overflows
+
+// Capture-side state (audio task only)
 int32_t sBuffer[BUFFER_LEN];
+uint64_t sampleIndex = 0;  // Running sample count, including dropped samples
+
+SpectrumAnalyzer spectrum;
+GoertzelBank<GOERTZEL_BANDS> goertzel;
+OnsetDetector onsetDetector;
+TempoTracker tempoTracker;
+
+// Render-side state (render task only)
 float volume = 0;
 float smoothVolume = 0;
 float maxVolume = MAX_VOLUME_TARGET;  // For serial plotter display
+float bandVolumes[GOERTZEL_BANDS] = {0};  // Smoothed Goertzel band volumes
+float beatVolume = 0;           // Level set instantly by an onset, decays per frame
+bool beatThisFrame = false;     // An onset arrived since the last rendered frame
+uint64_t lastBeatSample = 0;    // Sample index of the most recent onset
+uint32_t beatCount = 0;
+float frameBaselineNoise = 0;   // Noise floor the latest frame was measured against
 
-// Moving average filter for additional stability
-#define FILTER_SIZE 5
-float volumeFilter[FILTER_SIZE] = {0};
-int filterIndex = 0;
+// Musical clock from the tempo tracker, extrapolated between frames
+struct MusicalTime {
+  float bpm;         // 0 while the tracker has no lock
+  float beatPhase;   // 0..1 within the current beat
+  float barPhase;    // 0..1 within the current bar
+  uint32_t beat;     // Beats since start
+};
+float tempoBpm = 0;
+float tempoBeatPhase = 0;
+uint32_t tempoBeatNumber = 0;
+unsigned long tempoUpdatedAt = 0;
+float spectrumLevels[SPECTRUM_BANDS] = {0};  // Latest band energies (dB)
+float spectrumPeaks[SPECTRUM_BANDS] = {0};   // Slowly decaying per-band reference (dB)
 
 // Calibration variables
 float baselineNoise = 15000;  // Auto-calibrated on startup
 #define CALIBRATION_SAMPLES 100
 float dynamicScaleFactor = 2.0;  // Adjusted every 5 seconds
 
-#define MIN_VOLUME 1500
 #define SMOOTHING_FACTOR 0.8
 #define UPDATE_INTERVAL 5
 
@@ -51,154 +123,312 @@ int smoothVolumeIndex = 0;
 unsigned long lastCalibration = 0;
 float smoothVolumePeak = 0;  // Track the highest smoothed volume
 
-// LED FX engine
-WS2812FX ws2812fx = WS2812FX(LED_COUNT, LED_PIN, NEO_GRB + NEO_KHZ800);
-
 // ===============================
 // CALIBRATION
 // ===============================
-void calibrateBaseline() {
-  Serial.println("Calibrating baseline noise level...");
-  Serial.println("Please keep quiet for 3 seconds...");
-  
-  float totalNoise = 0;
-  int validSamples = 0;
-  
-  for (int sample = 0; sample < CALIBRATION_SAMPLES; sample++) {
-    size_t bytesIn = 0;
-    esp_err_t result = i2s_read(I2S_PORT, &sBuffer, BUFFER_LEN * sizeof(int32_t), &bytesIn, portMAX_DELAY);
-    
-    if (result == ESP_OK && bytesIn > 0) {
-      int16_t samples_read = bytesIn / sizeof(int32_t);
-      float sum = 0;
-      int actualSamples = 0;
-      
-      for (int16_t i = 0; i < samples_read; ++i) {
-        int32_t sample = sBuffer[i] >> 14;
-        // Filter out obvious spikes during calibration
-        if (abs(sample) < 50000) {
-          sum += (sample * sample);
-          actualSamples++;
-        }
-      }
-      
-      if (actualSamples > 0) {
-        float rms = sqrt(sum / actualSamples);
-        totalNoise += rms;
-        validSamples++;
+// The noise floor is measured from the normal capture path: one block in
+// every CALIBRATION_STRIDE is measured and baselineNoise follows the running
+// mean from the first measurement on, so the LEDs run while it converges.
+// Capture-side state (audio task only).
+#define CALIBRATION_STRIDE 20  // Blocks between measurements (~30 ms)
+bool calibrating = false;
+int calibrationCountdown = 0;
+int calibrationAttempts = 0;
+int calibrationValid = 0;
+float calibrationTotal = 0;
+
+// A restored floor is checked against the room over the same measurements:
+// blocks well under it mean the room is quieter than the floor claims, and
+// it is measured again. A louder room proves nothing, music may be playing.
+#define STATE_CHECK_FLOOR 0.5f  // Quietest block below this fraction of the floor fails
+bool checkingRestore = false;
+uint32_t restoreQuietest = 0;
+std::atomic<bool> restoreRejected{false};  // Read by the render task
+
+// Set from the render task to restart calibration at runtime
+std::atomic<bool> recalibrateRequested{false};
+
+void startRestoreCheck() {
+  checkingRestore = true;
+  calibrationCountdown = 0;
+  calibrationAttempts = 0;
+  restoreQuietest = UINT32_MAX;
+}
+
+void startCalibration() {
+  checkingRestore = false;
+  calibrating = true;
+  calibrationCountdown = 0;
+  calibrationAttempts = 0;
+  calibrationValid = 0;
+  calibrationTotal = 0;
+}
+
+// Measures the block in sBuffer when one is due. Returns 1 when calibration
+// finished on this block, -1 when it finished without a usable block, else 0.
+int calibrationStep(int16_t samples_read) {
+  if (!(calibrating || checkingRestore) || calibrationCountdown-- > 0) {
+    return 0;
+  }
+  calibrationCountdown = CALIBRATION_STRIDE - 1;
+  calibrationAttempts++;
+
+  // Filter out obvious spikes during calibration
+  BlockRms block = rmsQ31(sBuffer, samples_read, SAMPLE_SHIFT, CALIBRATION_SPIKE_LIMIT);
+  if (checkingRestore) {
+    if (block.validSamples > 0) {
+      restoreQuietest = min(restoreQuietest, block.rms);
+    }
+    if (calibrationAttempts >= CALIBRATION_SAMPLES) {
+      checkingRestore = false;
+      if (restoreQuietest < baselineNoise * STATE_CHECK_FLOOR) {
+        LOG_WARN("Restored baseline %.2f is above the room (%u), recalibrating\n",
+                 baselineNoise, (unsigned)restoreQuietest);
+        restoreRejected.store(true);
+        startCalibration();
       }
     }
-    delay(30); // 30ms delay between samples
+    return 0;
   }
-  
-  if (validSamples > 0) {
-    baselineNoise = totalNoise / validSamples;
-    Serial.print("Baseline calibrated to: ");
-    Serial.println(baselineNoise);
-  } else {
-    Serial.println("Calibration failed, using default");
+  if (block.validSamples > 0) {
+    calibrationTotal += block.rms;
+    calibrationValid++;
+    baselineNoise = calibrationTotal / calibrationValid;  // Provisional until done
   }
+
+  if (calibrationAttempts < CALIBRATION_SAMPLES) {
+    return 0;
+  }
+  calibrating = false;
+  return calibrationValid > 0 ? 1 : -1;
 }
 
 // ===============================
-// I2S SETUP
+// PERSISTENT STATE
 // ===============================
-void i2s_install() {
-  const i2s_config_t i2s_config = {
-    .mode = i2s_mode_t(I2S_MODE_MASTER | I2S_MODE_RX),
-    .sample_rate = 44100,
-    .bits_per_sample = I2S_BITS_PER_SAMPLE_32BIT,
-    .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
-    .communication_format = I2S_COMM_FORMAT_STAND_I2S,  // Changed from I2S_COMM_FORMAT_I2S
-    .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-    .dma_buf_count = 8,
-    .dma_buf_len = BUFFER_LEN,
-    .use_apll = false,
-    .tx_desc_auto_clear = false,
-    .fixed_mclk = 0
-  };
-
-  esp_err_t err = i2s_driver_install(I2S_PORT, &i2s_config, 0, NULL);
-  if (err != ESP_OK) {
-    Serial.print("I2S driver install failed: ");
-    Serial.println(err);
-  } else {
-    Serial.println("I2S driver installed successfully");
+// The calibration survives a reboot so a power blip does not mean seconds of
+// a dark or wrongly scaled strip. Flash wears out, so saves are rate limited:
+// the first calibration of a boot is saved straight away, anything else at
+// most once per STATE_SAVE_INTERVAL and only when a calibrated value moved
+// noticeably (the volume peak decays all the time and rides along). A
+// restore counts as a save.
+//
+// A calibration is reused for at most STATE_MAX_RESTORES boots before it is
+// measured afresh, and a restored floor is checked against the room (see
+// STATE_CHECK_FLOOR).
+#define STATE_MAGIC 0x4C534331  // "LSC1"
+#define STATE_VERSION 2
+#define STATE_SAVE_INTERVAL 300000  // Minimum ms between saves (5 minutes)
+#define STATE_SAVE_CHANGE 0.10f     // Relative change worth a save
+#define STATE_MAX_RESTORES 20       // Boots one calibration may be reused for
+
+struct SavedState {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;
+  float baselineNoise;
+  float smoothVolumePeak;
+  float dynamicScaleFactor;
+  uint32_t restores;  // Boots that reused this calibration
+  uint32_t checksum;  // FNV-1a over everything above
+};
+
+SavedState savedState = {};    // Last state written or restored
+bool stateSaved = false;       // A save happened during this boot
+bool stateDirty = false;       // A finished calibration is waiting to be saved
+unsigned long lastStateSave = 0;
+
+uint32_t stateChecksum(const SavedState& state) {
+  const uint8_t* bytes = (const uint8_t*)&state;
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < offsetof(SavedState, checksum); i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
   }
+  return hash;
 }
 
-void i2s_setpin() {
-  const i2s_pin_config_t pin_config = {
-    .bck_io_num = I2S_SCK,
-    .ws_io_num = I2S_WS,
-    .data_out_num = -1,
-    .data_in_num = I2S_SD
-  };
+// Rejects blobs from other firmware versions and values no calibration
+// could have produced
+bool stateIsValid(const SavedState& state) {
+  return state.magic == STATE_MAGIC && state.version == STATE_VERSION &&
+         state.size == sizeof(SavedState) && state.checksum == stateChecksum(state) &&
+         state.baselineNoise > 0 && state.baselineNoise < (float)CALIBRATION_SPIKE_LIMIT &&
+         state.smoothVolumePeak >= 0 && state.smoothVolumePeak <= MAX_VOLUME_TARGET &&
+         state.dynamicScaleFactor > 0 && state.dynamicScaleFactor < 100;
+}
 
-  esp_err_t err = i2s_set_pin(I2S_PORT, &pin_config);
-  if (err != ESP_OK) {
-    Serial.print("I2S pin config failed: ");
-    Serial.println(err);
-  } else {
-    Serial.println("I2S pins configured successfully");
+// Returns true when a valid state was restored and calibration can be skipped
+bool restoreState() {
+  SavedState state;
+  if (!hal::storage().load(&state, sizeof(state)) || !stateIsValid(state)) {
+    return false;
+  }
+  if (state.restores >= STATE_MAX_RESTORES) {
+    LOG_INFO("Saved calibration reused for %u boots, measuring afresh\n", (unsigned)state.restores);
+    return false;
+  }
+  // Count this boot, once per boot is well within what flash takes
+  state.restores++;
+  state.checksum = stateChecksum(state);
+  hal::storage().save(&state, sizeof(state));
+
+  baselineNoise = state.baselineNoise;
+  smoothVolumePeak = state.smoothVolumePeak;
+  dynamicScaleFactor = state.dynamicScaleFactor;
+  frameBaselineNoise = state.baselineNoise;
+  savedState = state;
+  // Counts as this boot's save, so the interval and change rules apply
+  stateSaved = true;
+  lastStateSave = hal::clock().millis();
+  startRestoreCheck();
+  return true;
+}
+
+bool changedNoticeably(float current, float saved) {
+  return fabsf(current - saved) > STATE_SAVE_CHANGE * max(fabsf(saved), 1.0f);
+}
+
+// Called from the render task; writes only when the rules above allow it
+void maybeSaveState(unsigned long now) {
+  // A restore that failed its check is no save, the new calibration is
+  if (restoreRejected.exchange(false)) {
+    stateSaved = false;
+  }
+  bool due = !stateSaved ? stateDirty : now - lastStateSave >= STATE_SAVE_INTERVAL;
+  if (!due) {
+    return;
+  }
+  bool changed = stateDirty ||
+                 changedNoticeably(frameBaselineNoise, savedState.baselineNoise) ||
+                 changedNoticeably(dynamicScaleFactor, savedState.dynamicScaleFactor);
+  if (!changed) {
+    return;
+  }
+
+  SavedState state = {};
+  state.magic = STATE_MAGIC;
+  state.version = STATE_VERSION;
+  state.size = sizeof(SavedState);
+  state.baselineNoise = frameBaselineNoise;
+  state.smoothVolumePeak = smoothVolumePeak;
+  state.dynamicScaleFactor = dynamicScaleFactor;
+  state.restores = stateDirty ? 0 : savedState.restores;  // A fresh calibration starts over
+  state.checksum = stateChecksum(state);
+
+  // Retry only after a full interval, a failing flash should not be hammered
+  stateSaved = true;
+  stateDirty = false;
+  lastStateSave = now;
+  if (hal::storage().save(&state, sizeof(state))) {
+    savedState = state;
+    LOG_INFO("State saved - Baseline: %.2f, Peak: %.2f, Scale: %.2f\n",
+             state.baselineNoise, state.smoothVolumePeak, state.dynamicScaleFactor);
   }
 }
 
 // ===============================
-// Volume-based LED animation
+// EFFECTS
 // ===============================
-void updateLedsByVolume() {
-  ws2812fx.stop();
-  ws2812fx.clear();
-
-  int numLedsToLight = 0;
-
-  if (smoothVolume > MIN_VOLUME && smoothVolumePeak > MIN_VOLUME) {
-    // Map volume to LED count using actual smoothed volume peak
-    if (smoothVolume >= smoothVolumePeak * 0.95f) {
-      numLedsToLight = LED_COUNT;  // Full LEDs at 95% of observed peak
-    } else {
-      float normalized = (smoothVolume - MIN_VOLUME) / (smoothVolumePeak - MIN_VOLUME);
-      normalized = pow(normalized, 0.7f);  // Gentle curve
-      numLedsToLight = constrain(round(normalized * LED_COUNT), 1, LED_COUNT);
-    }
+// What the LEDs show is the current effect (see effects.h); 's' on the
+// console steps through them
+EffectEngine effects;
+
+// Band energy as a fraction of the range shown below its running peak
+float bandLevel(int band) {
+  float level = (spectrumLevels[band] - (spectrumPeaks[band] - SPECTRUM_RANGE_DB)) / SPECTRUM_RANGE_DB;
+  return constrain(level, 0.0f, 1.0f);
+}
+
+// ===============================
+// LATENCY PROBE
+// ===============================
+// See latency.h. The audio task swaps the burst in for captured samples;
+// the render task follows it to the LEDs and paces the series.
+std::atomic<bool> latencyRequested{false};  // Set from the render task
+int latencyBurstLeft = 0;  // Burst samples still to inject (audio task only)
+
+// Render-side state (render task only)
+int latencyProbesLeft = 0;         // Probes still to run in this series
+bool latencyArmed = false;         // Burst requested, not arrived yet
+bool latencyWaiting = false;       // Burst arrived, LEDs not reacted yet
+unsigned long latencyNextAt = 0;   // When the next probe may start
+int latencyBaselineLit = 0;        // Pixels lit when the burst arrived
+LatencyStamps latencyStamps;
+
+// Overwrites the block in sBuffer while a burst runs. Returns true on the
+// block that starts one.
+bool latencyStep(int16_t samples_read) {
+  if (calibrating) {
+    latencyBurstLeft = 0;  // Keep bursts out of the noise floor; a request waits
+    return false;
   }
+  bool starting = latencyBurstLeft == 0 && latencyRequested.exchange(false);
+  if (starting) {
+    latencyBurstLeft = LATENCY_PROBE_MS * SAMPLE_RATE / 1000;
+  }
+  if (latencyBurstLeft == 0) {
+    return false;
+  }
+  int count = min((int)samples_read, latencyBurstLeft);
+  float level = min(baselineNoise + LATENCY_PROBE_LEVEL, SPIKE_LIMIT - 1.0f);
+  latencyFillBurst(sBuffer, count, (int32_t)level, SAMPLE_SHIFT);
+  latencyBurstLeft -= count;
+  return starting;
+}
 
-  // Light LEDs from center outward
-  int center = LED_COUNT / 2;  // Center point (30 for 60 LEDs)
-  
-  for (int i = 0; i < numLedsToLight; i++) {
-    int ledIndex;
-    
-    // Alternate between left and right of center
-    if (i % 2 == 0) {
-      // Even indices: go right from center
-      ledIndex = center + (i / 2);
-    } else {
-      // Odd indices: go left from center
-      ledIndex = center - 1 - (i / 2);
-    }
-    
-    // Make sure we don't go out of bounds
-    if (ledIndex >= 0 && ledIndex < LED_COUNT) {
-      // Calculate color based on distance from center (for gradient effect)
-      float distanceFromCenter = abs(ledIndex - center) / (float)(LED_COUNT / 2);
-      uint32_t color = (distanceFromCenter < 0.33) ? 0x00FF00 :   // green (center)
-                       (distanceFromCenter < 0.66) ? 0xFFFF00 :   // yellow (middle)
-                                                      0xFF0000;    // red (edges)
-      ws2812fx.setPixelColor(ledIndex, color);
-    }
+// Starts the series' next probe once the gap after the last one has passed
+void latencyPace(unsigned long now) {
+  if (latencyProbesLeft > 0 && !latencyArmed && !latencyWaiting && (long)(now - latencyNextAt) >= 0) {
+    latencyArmed = true;
+    latencyRequested.store(true);
+  }
+}
+
+// The burst's first block reached the render task
+void latencyArrived(const VolumeFrame& frame) {
+  if (smoothVolume > MIN_VOLUME) {
+    LOG_WARN("Latency - Burst arrived over sound, this probe may be off\n");
   }
+  latencyStamps.captured = frame.probeCaptured;
+  latencyStamps.modeled = hal::audio().sampleTimesModeled() ? 1 << LATENCY_CAPTURE : 0;
+  latencyStamps.read = frame.probeRead;
+  latencyStamps.published = frame.probePublished;
+  latencyStamps.consumed = hal::clock().micros();
+  latencyStamps.triggered = latencyStamps.consumed;
+  latencyBaselineLit = effects.litPixels();
+  latencyArmed = false;
+  latencyWaiting = true;
+}
 
-  ws2812fx.show();
+// Called after each render while a burst is on its way to the LEDs
+void latencyCheck(uint32_t renderStart, unsigned long now) {
+  uint32_t shown = hal::clock().micros();
+  if (effects.litPixels() >= latencyBaselineLit + LATENCY_PROBE_LEDS) {
+    latencyStamps.rendered = renderStart;
+    latencyStamps.shown = shown;
+    LedStats ledStats = hal::leds().stats();
+    latencyStamps.latched = shown + ledStats.transferMicros;
+    if (ledStats.transferModeled) {
+      latencyStamps.modeled |= 1 << LATENCY_WIRE;
+    }
+    latencyRecord(latencyStamps);
+  } else if (shown - latencyStamps.captured < LATENCY_PROBE_TIMEOUT_MS * 1000u) {
+    return;
+  } else {
+    latencyMissed();
+  }
+  latencyWaiting = false;
+  latencyNextAt = now + LATENCY_PROBE_GAP_MS;
+  if (--latencyProbesLeft == 0) {
+    latencySummary();
+  }
 }
 
 // ===============================
 // SETUP
 // ===============================
 void setup() {
-  Serial.begin(115200);
-  delay(1000);
+  hal::begin();
 
   // Initialize volume history arrays
   for (int i = 0; i < VOLUME_SAMPLES; i++) {
@@ -208,113 +438,585 @@ void setup() {
     smoothVolumeHistory[i] = 0;
   }
 
-  ws2812fx.init();
-  ws2812fx.setBrightness(BRIGHTNESS);
-  ws2812fx.setColor(0);              // black/off
-  ws2812fx.setMode(FX_MODE_STATIC);
-  ws2812fx.start();
-
-  Serial.println("Initializing I2S for SPH0645 microphone...");
-  i2s_install();
-  i2s_setpin();
+  hal::leds().begin();
+  registerEffects(effects);
+  if (!effects.select(LED_EFFECT)) {
+    effects.select(0);
+  }
+  hal::audio().begin();
+#if SPECTRUM_ENABLED
+  spectrum.begin(SAMPLE_RATE);
+#endif
+#if TEMPO_ENABLED
+  tempoTracker.begin(SAMPLE_RATE, FFT_HOP);
+#endif
+#if GOERTZEL_ENABLED
+  const float goertzelFrequencies[GOERTZEL_BANDS] = GOERTZEL_FREQUENCIES;
+  goertzel.begin(goertzelFrequencies, SAMPLE_RATE, GOERTZEL_WINDOW);
+#endif
   
-  esp_err_t err = i2s_start(I2S_PORT);
-  if (err != ESP_OK) {
-    Serial.print("I2S start failed: ");
-    Serial.println(err);
+#ifdef LIGHTSHOW_BENCH
+  runBenchmarks();
+#endif
+
+  // Reuse the last calibration when one was saved, otherwise calibrate the
+  // baseline noise level in the background
+  if (restoreState()) {
+    LOG_INFO("Restored calibration - Baseline: %.2f, Peak: %.2f, Scale: %.2f (send 'c' to recalibrate)\n",
+             baselineNoise, smoothVolumePeak, dynamicScaleFactor);
   } else {
-    Serial.println("I2S started successfully");
+    LOG_INFO("Calibrating baseline noise level, keep quiet for 3 seconds...\n");
+    startCalibration();
   }
+
+  // Audio captured during setup is stale
+  sampleIndex += hal::audio().discardPending();
+
+  // From here on messages queue instead of waiting on the UART
+  logDefer();
+
+#if LIGHTSHOW_TASKS
+  xTaskCreatePinnedToCore(logTask, "log", LOG_TASK_STACK, NULL,
+                          LOG_TASK_PRIORITY, NULL, LOG_TASK_CORE);
+  // Render task first so the audio task always has someone to notify
+  xTaskCreatePinnedToCore(renderTask, "render", RENDER_TASK_STACK, NULL,
+                          RENDER_TASK_PRIORITY, &renderTaskHandle, RENDER_TASK_CORE);
+  xTaskCreatePinnedToCore(audioTask, "audio", AUDIO_TASK_STACK, NULL,
+                          AUDIO_TASK_PRIORITY, &audioTaskHandle, AUDIO_TASK_CORE);
+#endif
   
-  // Calibrate baseline noise level
-  calibrateBaseline();
-  
-  Serial.println("Setup complete. Monitoring audio...");
+  LOG_INFO("Setup complete. Monitoring audio...\n");
 }
 
 // ===============================
-// LOOP
+// AUDIO TASK (core 0)
 // ===============================
-void loop() {
-  static unsigned long lastUpdate = 0;
-  unsigned long now = millis();
+// Moving average filter for additional stability
+#define FILTER_SIZE 5
 
-  // Read audio data
-  size_t bytesIn = 0;
-  esp_err_t result = i2s_read(I2S_PORT, &sBuffer, BUFFER_LEN * sizeof(int32_t), &bytesIn, portMAX_DELAY);
-  
-  if (result == ESP_OK && bytesIn > 0) {
-    // Calculate RMS (Root Mean Square) for better noise handling
-    float sum = 0;
-    int16_t samples_read = bytesIn / sizeof(int32_t);
-    int validSamples = 0;
+// Moving average, delta limiter and EMA applied to one volume signal
+struct VolumeSmoother {
+  float filter[FILTER_SIZE] = {0};
+  int index = 0;
+  float previous = 0;
+  float volume = 0;  // After moving average and delta limiter
+  float smooth = 0;  // After EMA smoothing
+
+  void update(float rawVolume) {
+    // Apply moving average filter
+    filter[index] = rawVolume;
+    index = (index + 1) % FILTER_SIZE;
     
-    for (int16_t i = 0; i < samples_read; ++i) {
-      int32_t sample = sBuffer[i] >> 14;  // SPH0645: shift 14 bits
-      
-      // Basic spike filter - ignore extreme outliers
-      if (abs(sample) < 100000) {  // Reasonable upper limit
-        sum += (sample * sample);  // Square for RMS
-        validSamples++;
-      }
+    float filteredVolume = 0;
+    for (int i = 0; i < FILTER_SIZE; i++) {
+      filteredVolume += filter[i];
     }
+    volume = filteredVolume / FILTER_SIZE;
     
-    if (validSamples > 0) {
-      float rms = sqrt(sum / validSamples);  // RMS calculation
-      
-      // Apply calibration and scaling
-      float calibratedVolume = max(0.0f, rms - baselineNoise);
-      
-      // Additional noise gate - ignore very small changes
-      if (calibratedVolume < 100) {
-        calibratedVolume = 0;
-      }
-      
-      float rawVolume = constrain(calibratedVolume * dynamicScaleFactor, 0.0f, MAX_VOLUME_TARGET);
-      
-      // Apply moving average filter
-      volumeFilter[filterIndex] = rawVolume;
-      filterIndex = (filterIndex + 1) % FILTER_SIZE;
-      
-      float filteredVolume = 0;
-      for (int i = 0; i < FILTER_SIZE; i++) {
-        filteredVolume += volumeFilter[i];
-      }
-      volume = filteredVolume / FILTER_SIZE;
-      
-      // Extra smoothing for stability
-      static float previousVolume = 0;
-      float volumeDelta = abs(volume - previousVolume);
-      
-      // If change is too dramatic, limit it
-      if (volumeDelta > MAX_VOLUME_TARGET * 0.3f) {
-        volume = previousVolume + (volume > previousVolume ? MAX_VOLUME_TARGET * 0.05f : -MAX_VOLUME_TARGET * 0.05f);
-      }
-      previousVolume = volume;
-      
-      smoothVolume = (smoothVolume * (1.0 - SMOOTHING_FACTOR)) + (volume * SMOOTHING_FACTOR);
-      
-      // Track smoothed volume peak
-      if (smoothVolume > smoothVolumePeak) {
-        smoothVolumePeak = smoothVolume;
+    // Extra smoothing for stability
+    float volumeDelta = abs(volume - previous);
+    
+    // If change is too dramatic, limit it
+    if (volumeDelta > MAX_VOLUME_TARGET * 0.3f) {
+      volume = previous + (volume > previous ? MAX_VOLUME_TARGET * 0.05f : -MAX_VOLUME_TARGET * 0.05f);
+    }
+    previous = volume;
+    
+    smooth = (smooth * (1.0 - SMOOTHING_FACTOR)) + (volume * SMOOTHING_FACTOR);
+  }
+};
+
+VolumeSmoother volumeSmoother;
+VolumeSmoother bandSmoothers[GOERTZEL_BANDS];
+
+// Runs the volume filter chain on the block in sBuffer.
+// Returns false when the block had no valid samples.
+bool processBlock(int16_t samples_read, VolumeFrame& frame) {
+  // Calculate RMS (Root Mean Square) for better noise handling,
+  // with a basic spike filter that ignores extreme outliers
+  BlockRms block;
+#if GOERTZEL_ENABLED
+  // The Goertzel bank rides along in the same pass over the samples
+  {
+    PROFILE_SCOPE(STAGE_RMS);
+    block = goertzel.process(sBuffer, samples_read, SAMPLE_SHIFT, SPIKE_LIMIT);
+  }
+  if (goertzel.isReady()) {
+    for (int band = 0; band < GOERTZEL_BANDS; band++) {
+      float bandVolume = constrain(goertzel.energies()[band] * dynamicScaleFactor, 0.0f, MAX_VOLUME_TARGET);
+      bandSmoothers[band].update(bandVolume);
+    }
+  }
+  for (int band = 0; band < GOERTZEL_BANDS; band++) {
+    frame.bandVolumes[band] = bandSmoothers[band].smooth;
+  }
+#else
+  {
+    PROFILE_SCOPE(STAGE_RMS);
+    block = rmsQ31(sBuffer, samples_read, SAMPLE_SHIFT, SPIKE_LIMIT);
+  }
+#endif
+  if (block.validSamples == 0) {
+    return false;
+  }
+
+  float rms = block.rms;
+  
+  // Apply calibration and scaling
+  float calibratedVolume = max(0.0f, rms - baselineNoise);
+  
+  // Additional noise gate - ignore very small changes
+  if (calibratedVolume < 100) {
+    calibratedVolume = 0;
+  }
+  
+  float rawVolume = constrain(calibratedVolume * dynamicScaleFactor, 0.0f, MAX_VOLUME_TARGET);
+  {
+    PROFILE_SCOPE(STAGE_FILTER);
+    volumeSmoother.update(rawVolume);
+  }
+
+  frame.rms = rms;
+  frame.calibratedVolume = calibratedVolume;
+  frame.rawVolume = rawVolume;
+  frame.volume = volumeSmoother.volume;
+  frame.smoothVolume = volumeSmoother.smooth;
+  return true;
+}
+
+// Runs the onset detector on the block just processed
+void detectOnset(VolumeFrame& frame, int16_t samples_read) {
+  PROFILE_SCOPE(STAGE_ONSET);
+  frame.hasOnset = false;
+  onsetDetector.addBlock(sBuffer, samples_read, SAMPLE_SHIFT, frame.sampleIndex);
+
+  OnsetEvent event;
+  uint64_t blockEnd = frame.sampleIndex + samples_read;
+#if SPECTRUM_ENABLED
+  // Spectral flux over the FFT bands, once per hop
+  if (!frame.hasSpectrum ||
+      !onsetDetector.process(frame.bands, SPECTRUM_BANDS, blockEnd, FFT_HOP, event)) {
+    return;
+  }
+#else
+  // Broadband energy flux, once per block
+  float levelDb = 20.0f * log10f(frame.rms + 1.0f);
+  if (!onsetDetector.process(&levelDb, 1, blockEnd, samples_read, event)) {
+    return;
+  }
+#endif
+
+  // Same noise gate as the volume: flux on the noise floor is not a beat
+  if (frame.rawVolume <= 0) {
+    return;
+  }
+
+  frame.hasOnset = true;
+  frame.onsetSample = event.sampleIndex;
+  frame.onsetStrength = event.strength;
+}
+
+// Feeds the tempo tracker and stamps the frame with the beat clock
+void trackTempo(VolumeFrame& frame, int16_t samples_read) {
+  PROFILE_SCOPE(STAGE_TEMPO);
+  uint64_t blockEnd = frame.sampleIndex + samples_read;
+  if (frame.hasSpectrum) {
+    tempoTracker.addEnvelope(onsetDetector.flux(), blockEnd);
+  }
+  if (frame.hasOnset) {
+    tempoTracker.addOnset(frame.onsetSample);
+  }
+  tempoTracker.advanceTo(blockEnd);
+
+  frame.bpm = tempoTracker.bpm();
+  frame.beatPhase = tempoTracker.beatPhase(blockEnd);
+  frame.beatNumber = tempoTracker.beatNumber();
+}
+
+// Hands one processed block to the render task
+void publishFrame(const VolumeFrame& frame) {
+  capturedBlocks.fetch_add(1, std::memory_order_relaxed);
+
+  // Never wait on the render side: if the queue is full the block is dropped
+  if (!frameQueue.push(frame)) {
+    droppedBlocks.fetch_add(1, std::memory_order_relaxed);
+    TRACE_MARK(TRACE_FRAME_DROPPED);
+  }
+
+  uint32_t depth = frameQueue.size();
+  if (depth > queueDepthMax.load(std::memory_order_relaxed)) {
+    queueDepthMax.store(depth, std::memory_order_relaxed);
+  }
+}
+
+// Waits for the next batch of captured blocks and processes all of them
+void audioStep() {
+  CaptureBatch batch;
+  bool ready;
+  {
+    PROFILE_SCOPE(STAGE_I2S_WAIT);
+    ready = hal::audio().waitForBlocks(batch);
+  }
+  if (!ready) {
+    return;
+  }
+
+  if (recalibrateRequested.exchange(false)) {
+    startCalibration();
+  }
+
+  if (batch.overflows > 0) {
+    TRACE_MARK(TRACE_CAPTURE_OVERFLOW);
+    // Lost samples precede everything still queued, so advance the sample
+    // index before stamping the blocks read below
+    captureOverflows.fetch_add(batch.overflows, std::memory_order_relaxed);
+    droppedSamples.fetch_add(batch.droppedSamples, std::memory_order_relaxed);
+    sampleIndex += batch.droppedSamples;
+  }
+
+  // Drain until nothing is left rather than one block per notification,
+  // so a block the events missed can't keep every later read behind
+  VolumeFrame frame;
+  for (;;) {
+    int16_t samples_read;
+    {
+      PROFILE_SCOPE(STAGE_I2S_READ);
+      samples_read = hal::audio().readBlock(sBuffer, BUFFER_LEN);
+    }
+    if (samples_read == 0) {
+      break;
+    }
+
+    frame.sampleIndex = sampleIndex;
+    sampleIndex += samples_read;
+
+    frame.latencyProbe = latencyStep(samples_read);
+    if (frame.latencyProbe) {
+      // The burst starts the block, so it entered with the block's first
+      // sample; any backlog in the DMA queue shows up as capture time
+      frame.probeRead = hal::clock().micros();
+      frame.probeCaptured = hal::audio().sampleMicros(frame.sampleIndex);
+    }
+
+    frame.calibrationResult = calibrationStep(samples_read);
+    frame.baselineNoise = baselineNoise;
+
+    frame.hasSpectrum = false;
+#if SPECTRUM_ENABLED
+    bool spectrumReady;
+    {
+      PROFILE_SCOPE(STAGE_FFT);
+      spectrumReady = spectrum.addSamples(sBuffer, samples_read, SAMPLE_SHIFT);
+    }
+    if (spectrumReady) {
+      frame.hasSpectrum = true;
+      memcpy(frame.bands, spectrum.bands(), sizeof(frame.bands));
+    }
+#endif
+
+    if (processBlock(samples_read, frame)) {
+#if ONSET_ENABLED
+      detectOnset(frame, samples_read);
+#else
+      frame.hasOnset = false;
+#endif
+#if TEMPO_ENABLED
+      trackTempo(frame, samples_read);
+#else
+      frame.bpm = 0;
+#endif
+      if (frame.latencyProbe) {
+        frame.probePublished = hal::clock().micros();
       }
-      
-      // Store for dynamic calibration
-      rawVolumeHistory[volumeIndex] = calibratedVolume;
-      volumeIndex = (volumeIndex + 1) % VOLUME_SAMPLES;
-      
-      // Store smoothed volume for peak analysis
-      smoothVolumeHistory[smoothVolumeIndex] = smoothVolume;
-      smoothVolumeIndex = (smoothVolumeIndex + 1) % SMOOTH_VOLUME_SAMPLES;
+      publishFrame(frame);
+    }
+  }
+
+#if LIGHTSHOW_TASKS
+  xTaskNotifyGive(renderTaskHandle);
+#endif
+}
+
+#if LIGHTSHOW_TASKS
+void audioTask(void*) {
+  for (;;) {
+    audioStep();
+  }
+}
+#endif
+
+// ===============================
+// RENDER TASK (core 1)
+// ===============================
+// Applies one block's features to the render-side state
+void consumeFrame(const VolumeFrame& frame) {
+  if (frame.latencyProbe) {
+    latencyArrived(frame);
+  } else if (latencyWaiting) {
+    latencyStamps.triggered = hal::clock().micros();
+  }
+
+  if (frame.calibrationResult > 0) {
+    LOG_INFO("Baseline calibrated to: %.2f\n", frame.baselineNoise);
+    stateDirty = true;
+  } else if (frame.calibrationResult < 0) {
+    LOG_WARN("Calibration failed, using %.2f\n", frame.baselineNoise);
+  }
+
+  frameBaselineNoise = frame.baselineNoise;
+  volume = frame.volume;
+  smoothVolume = frame.smoothVolume;
+
+  // Track smoothed volume peak
+  if (smoothVolume > smoothVolumePeak) {
+    smoothVolumePeak = smoothVolume;
+  }
+  
+  // Store for dynamic calibration
+  rawVolumeHistory[volumeIndex] = frame.calibratedVolume;
+  volumeIndex = (volumeIndex + 1) % VOLUME_SAMPLES;
+  
+  // Store smoothed volume for peak analysis
+  smoothVolumeHistory[smoothVolumeIndex] = smoothVolume;
+  smoothVolumeIndex = (smoothVolumeIndex + 1) % SMOOTH_VOLUME_SAMPLES;
+
+  for (int band = 0; band < GOERTZEL_BANDS; band++) {
+    bandVolumes[band] = frame.bandVolumes[band];
+  }
+
+  if (frame.hasOnset) {
+    TRACE_MARK(TRACE_ONSET);
+    beatVolume = max(beatVolume, frame.rawVolume);
+    beatThisFrame = true;
+    lastBeatSample = frame.onsetSample;
+    beatCount++;
+  }
+
+  tempoBpm = frame.bpm;
+  tempoBeatPhase = frame.beatPhase;
+  tempoBeatNumber = frame.beatNumber;
+  tempoUpdatedAt = hal::clock().millis();
+
+  if (frame.hasSpectrum) {
+    for (int band = 0; band < SPECTRUM_BANDS; band++) {
+      spectrumLevels[band] = frame.bands[band];
+      spectrumPeaks[band] = max(spectrumPeaks[band], frame.bands[band]);
+    }
+  }
+}
+
+// Beat and bar position right now, for animations that run on musical time
+MusicalTime musicalTime(unsigned long now) {
+  MusicalTime time = {tempoBpm, tempoBeatPhase, 0, tempoBeatNumber};
+  if (tempoBpm > 0) {
+    // Extrapolate from the last frame at the tracked tempo
+    time.beatPhase += (now - tempoUpdatedAt) * tempoBpm / 60000.0f;
+    while (time.beatPhase >= 1.0f) {
+      time.beatPhase -= 1.0f;
+      time.beat++;
+    }
+  }
+  time.barPhase = ((time.beat % TEMPO_BEATS_PER_BAR) + time.beatPhase) / TEMPO_BEATS_PER_BAR;
+  return time;
+}
+
+// Frames actually sent per second against what the wire allows. Strips
+// stream in parallel, so the ceiling depends on strip length, not count.
+void reportLedOutput(unsigned long now) {
+  static uint32_t lastSent = 0;
+  static unsigned long lastReport = 0;
+
+  LedStats ledStats = hal::leds().stats();
+  uint32_t sent = ledStats.frames - ledStats.skipped;
+  unsigned long elapsed = now - lastReport;
+  float sentPerSecond = elapsed > 0 ? (sent - lastSent) * 1000.0f / elapsed : 0;
+  float maxPerSecond = ledStats.transferMicros > 0 ? 1000000.0f / ledStats.transferMicros : 0;
+
+  LOG_DEBUG("LEDs - Strips: %d x %d %s, Frames: %u, Unchanged: %u, Sent/s: %.1f (max %.0f), "
+            "Waited: %u (avg %u us, max %u us), Wire time: %u us\n",
+            LED_STRIPS, LED_STRIP_LENGTH, LED_LAYOUT == LED_LAYOUT_SPAN ? "spanned" : "mirrored",
+            (unsigned)ledStats.frames, (unsigned)ledStats.skipped, sentPerSecond, maxPerSecond,
+            (unsigned)ledStats.waits,
+            (unsigned)(ledStats.waits > 0 ? ledStats.waitMicros / ledStats.waits : 0),
+            (unsigned)ledStats.maxWaitMicros, (unsigned)ledStats.transferMicros);
+
+  lastSent = sent;
+  lastReport = now;
+}
+
+// Reports FFT throughput and cost against the frame budget
+void reportSpectrumLoad(unsigned long now) {
+  static uint32_t lastFfts = 0;
+  static uint32_t lastCycles = 0;
+  static unsigned long lastReport = 0;
+
+  uint32_t ffts = spectrum.fftCount();
+  uint32_t cycles = spectrum.totalCycles();
+  uint32_t newFfts = ffts - lastFfts;
+  unsigned long elapsed = now - lastReport;
+
+  if (newFfts > 0 && elapsed > 0) {
+    uint32_t cyclesPerFft = (cycles - lastCycles) / newFfts;
+    float fftsPerSecond = newFfts * 1000.0f / elapsed;
+    float frameBudget = (float)UPDATE_INTERVAL * 1000 * hal::clock().cyclesPerMicrosecond();
+    LOG_DEBUG("Spectrum - FFTs/s: %.1f, Cycles per FFT: %u (%.2f%% of a %d ms frame)\n",
+              fftsPerSecond, (unsigned)cyclesPerFft, 100.0f * cyclesPerFft / frameBudget, UPDATE_INTERVAL);
+  }
+
+  lastFfts = ffts;
+  lastCycles = cycles;
+  lastReport = now;
+}
+
+// Render cost of the current effect against its budget
+void reportEffect() {
+  EffectStats stats = effects.takeStats();
+  LOG_DEBUG("Effect - %s, Quality: %d/%d, Render: avg %u us (max %u us), Output: avg %u us, "
+            "Budget: %u us, Downgrades: %u, Skipped: %u\n",
+            effects.current().name(), effects.quality(), effects.current().qualityLevels() - 1,
+            (unsigned)stats.renderMicros, (unsigned)stats.maxRenderMicros, (unsigned)stats.outputMicros,
+            (unsigned)stats.budgetMicros, (unsigned)stats.downgrades, (unsigned)stats.skipped);
+}
+
+#if TELEMETRY_BINARY
+// ===============================
+// TELEMETRY
+// ===============================
+// One binary frame per LED frame. Frames go through the log ring like text,
+// so only the log task ever waits on the UART; a full ring drops the frame.
+uint16_t telemetrySequence = 0;
+uint32_t telemetrySent = 0;
+uint32_t telemetryDropped = 0;
+uint32_t telemetryBytes = 0;
+
+void sendTelemetry(unsigned long now) {
+  PROFILE_SCOPE(STAGE_TELEMETRY);
+  TelemetrySample sample = {telemetrySequence++, (uint32_t)now, volume, smoothVolume, smoothVolumePeak};
+  uint8_t frame[TELEMETRY_FRAME_MAX];
+  size_t length = telemetryEncode(sample, frame);
+  if (logFrame(frame, length)) {
+    telemetrySent++;
+    telemetryBytes += length;
+  } else {
+    telemetryDropped++;
+  }
+}
+
+void reportTelemetry(unsigned long now) {
+  static uint32_t lastBytes = 0;
+  static unsigned long lastReport = 0;
+  unsigned long elapsed = now - lastReport;
+  LOG_DEBUG("Telemetry - Frames: %u, Dropped: %u, Bytes/s: %u\n", (unsigned)telemetrySent,
+            (unsigned)telemetryDropped,
+            (unsigned)(elapsed > 0 ? (telemetryBytes - lastBytes) * 1000ull / elapsed : 0));
+  lastBytes = telemetryBytes;
+  lastReport = now;
+}
+#endif
+
+// What the effects see this frame
+AudioFeatures audioFeatures(unsigned long now) {
+  AudioFeatures features;
+  features.now = now;
+  // Onsets bypass the smoothing so kicks hit within one frame
+  features.level = max(smoothVolume, beatVolume);
+  features.volumePeak = smoothVolumePeak;
+  features.silent = smoothVolume <= MIN_VOLUME;
+  for (int band = 0; band < SPECTRUM_BANDS; band++) {
+    features.bands[band] = bandLevel(band);
+  }
+  for (int band = 0; band < GOERTZEL_BANDS; band++) {
+    features.goertzelBands[band] = bandVolumes[band] / MAX_VOLUME_TARGET;
+  }
+  features.beat = beatThisFrame;
+  MusicalTime time = musicalTime(now);
+  features.bpm = time.bpm;
+  features.beatPhase = time.beatPhase;
+  features.barPhase = time.barPhase;
+  return features;
+}
+
+// Single-character commands from the serial console
+void pollCommands() {
+  int command;
+  while ((command = hal::log().read()) >= 0) {
+    switch (command) {
+      case 'c':
+        LOG_INFO("Recalibrating baseline noise level, keep quiet for 3 seconds...\n");
+        recalibrateRequested.store(true);
+        break;
+      case 's':
+        effects.next();
+        LOG_INFO("Effect: %s\n", effects.current().name());
+        break;
+      case 'p':
+#ifdef LIGHTSHOW_PROFILE
+        profileDump();
+#else
+        LOG_INFO("Build with -D LIGHTSHOW_PROFILE to profile the pipeline stages\n");
+#endif
+        break;
+      case 't':
+#ifdef LIGHTSHOW_TRACE
+        traceRequestDump();
+#else
+        LOG_INFO("Build with -D LIGHTSHOW_TRACE to record an event trace\n");
+#endif
+        break;
+      case 'l':
+        if (latencyProbesLeft > 0) {
+          LOG_INFO("Latency probe already running\n");
+          break;
+        }
+        LOG_INFO("Measuring latency with %d noise bursts, keep quiet...\n", LATENCY_PROBE_COUNT);
+        latencyBegin();
+        latencyProbesLeft = LATENCY_PROBE_COUNT;
+        latencyNextAt = hal::clock().millis();
+        break;
+      case 'v':
+        setLogLevel((LogLevel)((logLevel() + 1) % LOG_LEVEL_COUNT));
+        break;
+      default:
+        effects.command(command);  // e.g. 'm' cycles the VU curve
+        break;
+    }
+  }
+}
+
+void renderStep() {
+  PROFILE_SCOPE(STAGE_RENDER);
+  static unsigned long lastUpdate = 0;
+  unsigned long now = hal::clock().millis();
+
+  pollCommands();
+  latencyPace(now);
+
+  // Drain every block captured since the last pass
+  {
+    PROFILE_SCOPE(STAGE_CONSUME);
+    VolumeFrame frame;
+    while (frameQueue.pop(frame)) {
+      consumeFrame(frame);
     }
   }
 
   // Update LEDs and recalibrate periodically
-  if (now - lastUpdate > UPDATE_INTERVAL) {
-    updateLedsByVolume();
+  if (now - lastUpdate >= UPDATE_INTERVAL) {
+    uint32_t renderStart = hal::clock().micros();
+    effects.renderFrame(audioFeatures(now), hal::leds(), UPDATE_INTERVAL * 1000);
+    if (latencyWaiting) {
+      latencyCheck(renderStart, now);
+    }
+
+    for (int band = 0; band < SPECTRUM_BANDS; band++) {
+      spectrumPeaks[band] -= SPECTRUM_PEAK_DECAY_DB;
+    }
+    beatVolume *= BEAT_DECAY;
+    beatThisFrame = false;
     
     // Recalibrate based on smoothed volume peaks every 5 seconds
     if (now - lastCalibration >= CALIBRATION_WINDOW) {
+      PROFILE_SCOPE(STAGE_REPORTS);
       // Find peak smoothed volume in recent history
       float maxSmoothDetected = 0;
       for (int i = 0; i < SMOOTH_VOLUME_SAMPLES; i++) {
@@ -327,31 +1029,94 @@ void loop() {
       float calibrationPeak = max(maxSmoothDetected, smoothVolumePeak * 0.8f);
       
       if (calibrationPeak > MIN_VOLUME) {
-        Serial.print("Calibration - Peak: ");
-        Serial.print(calibrationPeak);
-        Serial.println("");
+        LOG_DEBUG("Calibration - Peak: %.2f\n", calibrationPeak);
       }
+
+      LOG_DEBUG("Audio - Blocks: %u, Dropped: %u, Queue depth: %u (max %u), Overflows: %u, Dropped samples: %u\n",
+                (unsigned)capturedBlocks.load(std::memory_order_relaxed),
+                (unsigned)droppedBlocks.load(std::memory_order_relaxed),
+                (unsigned)frameQueue.size(),
+                (unsigned)queueDepthMax.load(std::memory_order_relaxed),
+                (unsigned)captureOverflows.load(std::memory_order_relaxed),
+                (unsigned)droppedSamples.load(std::memory_order_relaxed));
+      reportLedOutput(now);
+      reportEffect();
+#if TELEMETRY_BINARY
+      reportTelemetry(now);
+#endif
+#if SPECTRUM_ENABLED
+      reportSpectrumLoad(now);
+#endif
+#if TEMPO_ENABLED
+      if (tempoTracker.hopCount() > 0) {
+        LOG_DEBUG("Tempo - BPM: %.1f, Confidence: %.2f, Cycles per hop: %u\n",
+                  tempoBpm, tempoTracker.confidence(),
+                  (unsigned)(tempoTracker.totalCycles() / tempoTracker.hopCount()));
+      }
+#endif
+#if ONSET_ENABLED
+      LOG_DEBUG("Onsets - Count: %u, Last at sample: %llu\n",
+                (unsigned)beatCount, (unsigned long long)lastBeatSample);
+#endif
       
       // Decay the peak slightly over time to allow for re-calibration
       smoothVolumePeak *= 0.95f;
       
       lastCalibration = now;
     }
+
+    maybeSaveState(now);
     
+#if TELEMETRY_BINARY
+    sendTelemetry(now);
+#else
     // Serial plotter output
-    Serial.print("MinRange:");
-    Serial.print(-1000);
-    Serial.print(",Volume:");
-    Serial.print(volume);
-    Serial.print(",SmoothVolume:");
-    Serial.print(smoothVolume);
-    Serial.print(",SmoothPeak:");
-    Serial.print(smoothVolumePeak);
-    Serial.print(",MaxRange:");
-    Serial.println(4000);
+    LOG_DEBUG("MinRange:%d,Volume:%.2f,SmoothVolume:%.2f,SmoothPeak:%.2f,MaxRange:%d\n",
+              -1000, volume, smoothVolume, smoothVolumePeak, 4000);
+#endif
     
     lastUpdate = now;
   }
 
-  ws2812fx.service();
-}
\ No newline at end of file
+  PROFILE_SCOPE(STAGE_LED_SERVICE);
+  hal::leds().service();
+}
+
+#if LIGHTSHOW_TASKS
+void renderTask(void*) {
+  for (;;) {
+    // Woken by each captured block; the timeout keeps frames going in silence
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(UPDATE_INTERVAL));
+    renderStep();
+  }
+}
+
+// ===============================
+// LOG TASK (core 0, lowest priority)
+// ===============================
+// The only place that waits on the UART for log text, telemetry frames and
+// trace dumps
+void logTask(void*) {
+  for (;;) {
+    TRACE_SERVICE();
+    if (logDrain() == 0) {
+      vTaskDelay(pdMS_TO_TICKS(LOG_IDLE_MS));
+    }
+  }
+}
+#endif
+
+// ===============================
+// LOOP
+// ===============================
+void loop() {
+#if LIGHTSHOW_TASKS
+  // All work happens in the pinned audio, render and log tasks
+  vTaskDelete(NULL);
+#else
+  audioStep();
+  renderStep();
+  TRACE_SERVICE();
+  logDrain();
+#endif
+}
@@ -0,0 +1,94 @@
+#include <algorithm>
+
+#include "onset.h"
+
+void OnsetDetector::addBlock(const int32_t* samples, size_t count, int shift, uint64_t sampleIndex) {
+  uint32_t loudest = 0;
+  size_t loudestAt = 0;
+  for (size_t i = 0; i < count; i++) {
+    int32_t sample = samples[i] >> shift;
+    uint32_t magnitude = sample < 0 ? (uint32_t)(-sample) : (uint32_t)sample;
+    if (magnitude > loudest) {
+      loudest = magnitude;
+      loudestAt = i;
+    }
+  }
+
+  peakSample[peakIndex] = sampleIndex + loudestAt;
+  peakLevel[peakIndex] = loudest;
+  peakIndex = (peakIndex + 1) % ONSET_PEAK_BLOCKS;
+}
+
+bool OnsetDetector::process(const float* bandsDb, int bandCount, uint64_t hopEnd, uint32_t hopSamples,
+                            OnsetEvent& event) {
+  if (bandCount > ONSET_MAX_BANDS) {
+    bandCount = ONSET_MAX_BANDS;
+  }
+
+  // Only rising energy counts: decays and releases are not onsets. Rises
+  // are measured against the louder of the two previous hops, which keeps
+  // frame-to-frame jitter on sustained notes and noise out of the flux.
+  float flux = 0;
+  for (int b = 0; b < bandCount; b++) {
+    float reference = previous[b] > older[b] ? previous[b] : older[b];
+    float rise = bandsDb[b] - reference;
+    if (rise > 0 && primed) {
+      flux += rise;
+    }
+    older[b] = previous[b];
+    previous[b] = bandsDb[b];
+  }
+  primed = true;
+
+  float threshold = (historyCount > 0 ? median() : 0) * ONSET_THRESHOLD_SCALE + ONSET_THRESHOLD_OFFSET;
+
+  history[historyIndex] = flux;
+  historyIndex = (historyIndex + 1) % ONSET_MEDIAN_WINDOW;
+  if (historyCount < ONSET_MEDIAN_WINDOW) {
+    historyCount++;
+  }
+
+  lastFlux = flux;
+  lastThreshold = threshold;
+
+  // Fire on the first hop above the threshold, then hold off for the
+  // refractory period so one transient is reported once
+  if (flux <= threshold || (anyOnset && hopEnd - lastOnset < ONSET_MIN_GAP)) {
+    return false;
+  }
+
+  uint64_t hopStart = hopEnd > hopSamples ? hopEnd - hopSamples : 0;
+  event.sampleIndex = locate(hopStart, hopEnd);
+  event.strength = flux / threshold;
+  lastOnset = hopEnd;
+  anyOnset = true;
+  onsets++;
+  return true;
+}
+
+float OnsetDetector::median() {
+  std::copy(history, history + historyCount, scratch);
+  float* middle = scratch + historyCount / 2;
+  std::nth_element(scratch, middle, scratch + historyCount);
+  return *middle;
+}
+
+// The transient is placed at the peak of the first block in the hop that
+// reaches half of the hop's loudest block
+uint64_t OnsetDetector::locate(uint64_t hopStart, uint64_t hopEnd) {
+  uint32_t loudest = 0;
+  for (int i = 0; i < ONSET_PEAK_BLOCKS; i++) {
+    if (peakSample[i] >= hopStart && peakSample[i] < hopEnd && peakLevel[i] > loudest) {
+      loudest = peakLevel[i];
+    }
+  }
+
+  uint64_t best = hopEnd;
+  for (int i = 0; i < ONSET_PEAK_BLOCKS; i++) {
+    if (peakSample[i] >= hopStart && peakSample[i] < hopEnd && peakLevel[i] * 2 >= loudest &&
+        peakSample[i] < best) {
+      best = peakSample[i];
+    }
+  }
+  return best == hopEnd ? hopStart : best;
+}
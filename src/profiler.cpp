@@ -0,0 +1,73 @@
+#ifdef LIGHTSHOW_PROFILE
+
+#include <atomic>
+
+#include "hal.h"
+#include "log.h"
+#include "profiler.h"
+
+struct StageHistogram {
+  uint32_t window;  // Dump window the figures belong to
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint32_t buckets[PROFILE_BUCKETS];
+};
+
+static StageHistogram histograms[STAGE_COUNT];
+static std::atomic<uint32_t> profileWindow{1};  // Histograms start stale, i.e. cleared
+
+// Bucket 0 holds zero, bucket b durations with b significant bits
+static int bucketFor(uint32_t cycles) {
+  return cycles == 0 ? 0 : 32 - __builtin_clz(cycles);
+}
+
+void profileRecord(ProfileStage stage, uint32_t cycles) {
+  StageHistogram& histogram = histograms[stage];
+  uint32_t window = profileWindow.load(std::memory_order_relaxed);
+  if (histogram.window != window) {
+    histogram = {};
+    histogram.window = window;
+    histogram.min = UINT32_MAX;
+  }
+  histogram.count++;
+  histogram.min = cycles < histogram.min ? cycles : histogram.min;
+  histogram.max = cycles > histogram.max ? cycles : histogram.max;
+  histogram.buckets[bucketFor(cycles)]++;
+}
+
+// Upper bound of the bucket holding the given fraction of the samples,
+// kept inside the observed range
+static uint32_t percentile(const StageHistogram& histogram, float fraction) {
+  uint32_t target = (uint32_t)(histogram.count * fraction + 0.5f);
+  target = target < 1 ? 1 : target;
+  uint32_t seen = 0;
+  for (int bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+    seen += histogram.buckets[bucket];
+    if (seen >= target) {
+      uint32_t bound = bucket == 0 ? 0 : (bucket == 32 ? UINT32_MAX : (1u << bucket) - 1);
+      return bound < histogram.min ? histogram.min : (bound > histogram.max ? histogram.max : bound);
+    }
+  }
+  return histogram.max;
+}
+
+void profileDump() {
+  uint32_t window = profileWindow.load(std::memory_order_relaxed);
+  float cyclesPerMicro = hal::clock().cyclesPerMicrosecond();
+
+  // On demand, so shown at every level
+  LOG_ERROR("Profile (us)      count        min        p50        p99        max\n");
+  for (int stage = 0; stage < STAGE_COUNT; stage++) {
+    StageHistogram histogram = histograms[stage];
+    if (histogram.window != window || histogram.count == 0) {
+      continue;  // Did not run in this window
+    }
+    LOG_ERROR("  %-12s %9u %10.1f %10.1f %10.1f %10.1f\n", profileStageName((ProfileStage)stage), (unsigned)histogram.count,
+              histogram.min / cyclesPerMicro, percentile(histogram, 0.50f) / cyclesPerMicro,
+              percentile(histogram, 0.99f) / cyclesPerMicro, histogram.max / cyclesPerMicro);
+  }
+  profileWindow.store(window + 1, std::memory_order_relaxed);
+}
+
+#endif
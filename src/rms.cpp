@@ -0,0 +1,55 @@
+#include "rms.h"
+
+uint32_t isqrt64(uint64_t value) {
+  // Classic bit-by-bit square root: one result bit per iteration
+  uint64_t remainder = value;
+  uint64_t root = 0;
+  uint64_t bit = 1ULL << 62;
+
+  while (bit > remainder) {
+    bit >>= 2;
+  }
+  while (bit != 0) {
+    if (remainder >= root + bit) {
+      remainder -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+
+  // Round to nearest: value - root^2 > root  <=>  (root + 0.5)^2 < value.
+  // Roots just under 2^32 saturate instead of wrapping to zero.
+  if (remainder > root && root < UINT32_MAX) {
+    root++;
+  }
+  return (uint32_t)root;
+}
+
+BlockRms finishRms(uint64_t sumSquares, uint16_t validSamples) {
+  BlockRms result = {0, validSamples};
+  if (validSamples > 0) {
+    result.rms = isqrt64((sumSquares + validSamples / 2) / validSamples);
+  }
+  return result;
+}
+
+BlockRms rmsQ31(const int32_t* samples, size_t count, int shift, uint32_t spikeLimit) {
+  uint64_t sumSquares = 0;
+  uint16_t validSamples = 0;
+
+  for (size_t i = 0; i < count; ++i) {
+    int32_t sample = samples[i] >> shift;
+    uint32_t magnitude = sample < 0 ? (uint32_t)(-sample) : (uint32_t)sample;
+
+    // Spike filter - outliers are skipped, not clamped, so they cannot
+    // drag the block level up
+    if (magnitude < spikeLimit) {
+      sumSquares += (uint64_t)magnitude * magnitude;  // 32x32 -> 64 MAC
+      validSamples++;
+    }
+  }
+
+  return finishRms(sumSquares, validSamples);
+}
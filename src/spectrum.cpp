@@ -0,0 +1,131 @@
+#include "platform.h"
+
+#include "hal.h"
+#include "spectrum.h"
+
+#define HALF_FFT (FFT_SIZE / 2)
+
+static_assert((FFT_SIZE & (FFT_SIZE - 1)) == 0, "FFT_SIZE must be a power of two");
+static_assert(FFT_HOP > 0 && FFT_HOP <= FFT_SIZE, "FFT_HOP must be within FFT_SIZE");
+
+void SpectrumAnalyzer::begin(float sampleRate) {
+  for (int i = 0; i < FFT_SIZE; i++) {
+    window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / FFT_SIZE);
+    history[i] = 0;
+  }
+
+  // Twiddles for the full-length split step; the half-length FFT uses every
+  // other entry
+  for (int i = 0; i < HALF_FFT; i++) {
+    cosTable[i] = cosf(2.0f * (float)M_PI * i / FFT_SIZE);
+    sinTable[i] = -sinf(2.0f * (float)M_PI * i / FFT_SIZE);
+  }
+
+  int bits = 0;
+  while ((1 << bits) < HALF_FFT) {
+    bits++;
+  }
+  for (int i = 0; i < HALF_FFT; i++) {
+    uint16_t reversed = 0;
+    for (int b = 0; b < bits; b++) {
+      if (i & (1 << b)) {
+        reversed |= 1 << (bits - 1 - b);
+      }
+    }
+    bitReverse[i] = reversed;
+  }
+
+  // Log-spaced band edges, each band at least one bin wide
+  float binHz = sampleRate / FFT_SIZE;
+  float ratio = powf((float)SPECTRUM_MAX_HZ / SPECTRUM_MIN_HZ, 1.0f / SPECTRUM_BANDS);
+  float edgeHz = SPECTRUM_MIN_HZ;
+  int previous = 0;  // Bin 0 (DC) is never used
+  for (int b = 0; b <= SPECTRUM_BANDS; b++) {
+    int bin = (int)(edgeHz / binHz + 0.5f);
+    bin = constrain(bin, previous + 1, HALF_FFT - (SPECTRUM_BANDS - b));
+    bandStart[b] = bin;
+    previous = bin;
+    edgeHz *= ratio;
+  }
+
+  for (int b = 0; b < SPECTRUM_BANDS; b++) {
+    bandDb[b] = 0;
+  }
+}
+
+bool SpectrumAnalyzer::addSamples(const int32_t* samples, size_t count, int shift) {
+  bool ready = false;
+  for (size_t i = 0; i < count; i++) {
+    // Shift the history only once per hop, not per sample
+    history[FFT_SIZE - FFT_HOP + pending] = (float)(samples[i] >> shift);
+    pending++;
+    if (pending == FFT_HOP) {
+      runFft();
+      memmove(history, history + FFT_HOP, (FFT_SIZE - FFT_HOP) * sizeof(float));
+      pending = 0;
+      ready = true;
+    }
+  }
+  return ready;
+}
+
+void SpectrumAnalyzer::runFft() {
+  uint32_t start = hal::clock().cycles();
+
+  // Pack the windowed real input as a half-length complex sequence:
+  // even samples in the real part, odd samples in the imaginary part
+  for (int n = 0; n < HALF_FFT; n++) {
+    int slot = bitReverse[n];
+    re[slot] = history[2 * n] * window[2 * n];
+    im[slot] = history[2 * n + 1] * window[2 * n + 1];
+  }
+  transform();
+
+  // Split into the real signal's spectrum and sum the power per band
+  int band = 0;
+  float bandPower = 0;
+  for (int k = 1; k < HALF_FFT && band < SPECTRUM_BANDS; k++) {
+    int mirror = HALF_FFT - k;
+    float evenRe = 0.5f * (re[k] + re[mirror]);
+    float evenIm = 0.5f * (im[k] - im[mirror]);
+    float oddRe = 0.5f * (im[k] + im[mirror]);
+    float oddIm = -0.5f * (re[k] - re[mirror]);
+    float binRe = evenRe + cosTable[k] * oddRe - sinTable[k] * oddIm;
+    float binIm = evenIm + cosTable[k] * oddIm + sinTable[k] * oddRe;
+
+    if (k < bandStart[band]) {
+      continue;
+    }
+    bandPower += binRe * binRe + binIm * binIm;
+    if (k + 1 == bandStart[band + 1]) {
+      bandDb[band] = 10.0f * log10f(bandPower + 1.0f);
+      bandPower = 0;
+      band++;
+    }
+  }
+
+  cycles += hal::clock().cycles() - start;
+  ffts++;
+}
+
+// In-place iterative radix-2 FFT over re/im (input already bit-reversed)
+void SpectrumAnalyzer::transform() {
+  for (int size = 2; size <= HALF_FFT; size <<= 1) {
+    int half = size >> 1;
+    int step = FFT_SIZE / size;  // Twiddle stride in the full-length table
+    for (int start = 0; start < HALF_FFT; start += size) {
+      for (int j = 0; j < half; j++) {
+        float wr = cosTable[j * step];
+        float wi = sinTable[j * step];
+        int a = start + j;
+        int b = a + half;
+        float tr = re[b] * wr - im[b] * wi;
+        float ti = re[b] * wi + im[b] * wr;
+        re[b] = re[a] - tr;
+        im[b] = im[a] - ti;
+        re[a] += tr;
+        im[a] += ti;
+      }
+    }
+  }
+}
@@ -0,0 +1,107 @@
+#include "telemetry.h"
+
+uint16_t crc16(const uint8_t* data, size_t length) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+size_t cobsEncode(const uint8_t* in, size_t length, uint8_t* out) {
+  size_t code = 0;  // Where the current run's length byte goes
+  size_t written = 1;
+  uint8_t run = 1;
+  for (size_t i = 0; i < length; i++) {
+    if (in[i] == 0) {
+      out[code] = run;
+      code = written++;
+      run = 1;
+    } else {
+      out[written++] = in[i];
+      run++;
+    }
+  }
+  out[code] = run;
+  return written;
+}
+
+size_t cobsDecode(const uint8_t* in, size_t length, uint8_t* out) {
+  size_t read = 0;
+  size_t written = 0;
+  while (read < length) {
+    uint8_t run = in[read++];
+    if (run == 0 || read + run - 1 > length) {
+      return 0;
+    }
+    for (uint8_t i = 1; i < run; i++) {
+      out[written++] = in[read++];
+    }
+    // Every run but the last stands for a zero
+    if (read < length) {
+      out[written++] = 0;
+    }
+  }
+  return written;
+}
+
+static void putU16(uint8_t* at, uint16_t value) {
+  at[0] = value;
+  at[1] = value >> 8;
+}
+
+static void putU32(uint8_t* at, uint32_t value) {
+  putU16(at, value);
+  putU16(at + 2, value >> 16);
+}
+
+static uint16_t getU16(const uint8_t* at) {
+  return at[0] | (at[1] << 8);
+}
+
+static uint32_t getU32(const uint8_t* at) {
+  return getU16(at) | ((uint32_t)getU16(at + 2) << 16);
+}
+
+// Rounds to the fixed-point step, clamped to the field
+static uint16_t toFixed(float value) {
+  float scaled = value * TELEMETRY_VOLUME_SCALE + 0.5f;
+  return scaled <= 0 ? 0 : (scaled >= 65535 ? 65535 : (uint16_t)scaled);
+}
+
+size_t telemetryEncode(const TelemetrySample& sample, uint8_t* frame) {
+  uint8_t payload[TELEMETRY_PAYLOAD_SIZE];
+  payload[0] = TELEMETRY_SCHEMA;
+  putU16(payload + 1, sample.sequence);
+  putU32(payload + 3, sample.timeMs);
+  putU16(payload + 7, toFixed(sample.volume));
+  putU16(payload + 9, toFixed(sample.smoothVolume));
+  putU16(payload + 11, toFixed(sample.smoothPeak));
+  putU16(payload + 13, crc16(payload, TELEMETRY_PAYLOAD_SIZE - 2));
+
+  frame[0] = 0;
+  size_t length = 1 + cobsEncode(payload, sizeof(payload), frame + 1);
+  frame[length++] = 0;
+  return length;
+}
+
+bool telemetryDecode(const uint8_t* chunk, size_t length, TelemetrySample& sample) {
+  if (length != TELEMETRY_PAYLOAD_SIZE + 1) {
+    return false;
+  }
+  uint8_t payload[TELEMETRY_PAYLOAD_SIZE + 1];
+  if (cobsDecode(chunk, length, payload) != TELEMETRY_PAYLOAD_SIZE ||
+      payload[0] != TELEMETRY_SCHEMA ||
+      getU16(payload + 13) != crc16(payload, TELEMETRY_PAYLOAD_SIZE - 2)) {
+    return false;
+  }
+  sample.sequence = getU16(payload + 1);
+  sample.timeMs = getU32(payload + 3);
+  sample.volume = getU16(payload + 7) / (float)TELEMETRY_VOLUME_SCALE;
+  sample.smoothVolume = getU16(payload + 9) / (float)TELEMETRY_VOLUME_SCALE;
+  sample.smoothPeak = getU16(payload + 11) / (float)TELEMETRY_VOLUME_SCALE;
+  return true;
+}
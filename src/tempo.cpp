@@ -0,0 +1,141 @@
+#include "platform.h"
+
+#include "hal.h"
+#include "tempo.h"
+
+#define ENVELOPE_MASK (TEMPO_ENVELOPE_LEN - 1)
+
+static_assert((TEMPO_ENVELOPE_LEN & ENVELOPE_MASK) == 0, "TEMPO_ENVELOPE_LEN must be a power of two");
+
+void TempoTracker::begin(float newSampleRate, uint32_t hopSamples) {
+  sampleRate = newSampleRate;
+  hop = hopSamples;
+  rate = sampleRate / hop;
+  minLag = (int)(60.0f * rate / TEMPO_MAX_BPM);
+  maxLag = (int)(60.0f * rate / TEMPO_MIN_BPM + 1);
+  if (maxLag >= TEMPO_ENVELOPE_LEN / 2) {
+    maxLag = TEMPO_ENVELOPE_LEN / 2 - 1;
+  }
+  nextLag = minLag - 1;  // Lag 0 slot first: it normalizes the sweep
+}
+
+void TempoTracker::addEnvelope(float value, uint64_t hopEnd) {
+  uint32_t start = hal::clock().cycles();
+
+  envelopeSum += value - envelope[head];
+  envelope[head] = value;
+  head = (head + 1) & ENVELOPE_MASK;
+  if (filled < TEMPO_ENVELOPE_LEN) {
+    filled++;
+  }
+
+  // A few autocorrelation lags per hop; slot minLag - 1 holds lag 0
+  if (filled == TEMPO_ENVELOPE_LEN) {
+    float mean = envelopeSum / TEMPO_ENVELOPE_LEN;
+    for (int n = 0; n < TEMPO_LAGS_PER_HOP; n++) {
+      int lag = nextLag < minLag ? 0 : nextLag;
+      float sum = 0;
+      for (int i = lag; i < TEMPO_ENVELOPE_LEN; i++) {
+        int a = (head + i) & ENVELOPE_MASK;
+        int b = (head + i - lag) & ENVELOPE_MASK;
+        sum += (envelope[a] - mean) * (envelope[b] - mean);
+      }
+      acf[lag] = sum;
+
+      if (++nextLag > maxLag) {
+        finishSweep(hopEnd);
+        nextLag = minLag - 1;
+      }
+    }
+  }
+
+  cycles += hal::clock().cycles() - start;
+  hops++;
+}
+
+// Picks the strongest lag once every lag in range has been refreshed
+void TempoTracker::finishSweep(uint64_t hopEnd) {
+  if (acf[0] <= 0) {
+    return;
+  }
+
+  int best = 0;
+  float bestScore = 0;
+  for (int lag = minLag + 1; lag < maxLag; lag++) {
+    // Local maxima only, mildly weighted towards 120 BPM to settle octave
+    // ambiguity the way most listeners would
+    if (acf[lag] < acf[lag - 1] || acf[lag] < acf[lag + 1]) {
+      continue;
+    }
+    float octaves = log2f((60.0f * rate / lag) / 120.0f);
+    float score = acf[lag] * expf(-0.5f * octaves * octaves);
+    if (score > bestScore) {
+      bestScore = score;
+      best = lag;
+    }
+  }
+
+  lastConfidence = best > 0 ? acf[best] / acf[0] : 0;
+  if (best == 0 || lastConfidence < TEMPO_MIN_CONFIDENCE) {
+    return;
+  }
+
+  // Parabolic interpolation for a sub-hop period
+  float left = acf[best - 1];
+  float centre = acf[best];
+  float right = acf[best + 1];
+  float denominator = left - 2 * centre + right;
+  float offset = denominator != 0 ? 0.5f * (left - right) / denominator : 0;
+  float estimate = best + constrain(offset, -0.5f, 0.5f);
+
+  if (!locked || fabsf(estimate - period) > 0.1f * period) {
+    // First estimate or a tempo change: take it directly
+    period = estimate;
+    if (!locked) {
+      lastBeat = nextBeat = (double)hopEnd;
+    }
+    locked = true;
+  } else {
+    period += 0.25f * (estimate - period);
+  }
+}
+
+void TempoTracker::advanceTo(uint64_t sampleIndex) {
+  if (!locked) {
+    return;
+  }
+  double periodSamples = (double)period * hop;
+  while ((double)sampleIndex >= nextBeat) {
+    lastBeat = nextBeat;
+    nextBeat += periodSamples;
+    beats++;
+  }
+}
+
+void TempoTracker::addOnset(uint64_t sampleIndex) {
+  if (!locked) {
+    return;
+  }
+  advanceTo(sampleIndex);
+
+  // Error to the nearest beat, positive when the onset is late
+  double sinceLast = (double)sampleIndex - lastBeat;
+  double untilNext = nextBeat - (double)sampleIndex;
+  double error = sinceLast < untilNext ? sinceLast : -untilNext;
+  double periodSamples = (double)period * hop;
+  if (fabs(error) > TEMPO_LOCK_WINDOW * periodSamples) {
+    return;  // Off-beat onset: syncopation, not timing drift
+  }
+
+  lastBeat += TEMPO_PHASE_GAIN * error;
+  nextBeat += TEMPO_PHASE_GAIN * error;
+  period += TEMPO_PERIOD_GAIN * (float)(error / hop);
+}
+
+float TempoTracker::beatPhase(uint64_t sampleIndex) const {
+  if (!locked || nextBeat <= lastBeat) {
+    return 0;
+  }
+  float phase = (float)(((double)sampleIndex - lastBeat) / (nextBeat - lastBeat));
+  return constrain(phase, 0.0f, 1.0f);
+}
@@ -0,0 +1,82 @@
+#ifdef LIGHTSHOW_TRACE
+
+#include "platform.h"
+
+#include <atomic>
+
+#include "config.h"
+#include "hal.h"
+#include "profiler.h"
+#include "trace.h"
+
+static_assert(TRACE_EVENTS >= 2 && (TRACE_EVENTS & (TRACE_EVENTS - 1)) == 0,
+              "TRACE_EVENTS must be a power of two");
+static_assert(STAGE_COUNT <= TRACE_MARK_BASE, "Profile stages overlap the trace marks");
+
+static TraceEvent traceEvents[TRACE_EVENTS];
+static std::atomic<uint32_t> traceHead{0};  // Events recorded since the last dump
+static std::atomic<bool> tracePaused{false};
+static std::atomic<bool> dumpRequested{false};
+
+static const char* const markNames[] = {
+  "onset", "frame dropped", "capture overflow", "led wait", "effect downgrade",
+};
+static_assert(sizeof(markNames) / sizeof(markNames[0]) == TRACE_MARK_END - TRACE_MARK_BASE,
+              "One name per trace mark");
+
+static uint8_t currentCore() {
+#if LIGHTSHOW_TASKS
+  return xPortGetCoreID();
+#else
+  return 0;
+#endif
+}
+
+void traceEventAt(char type, uint16_t id, uint32_t cycles) {
+  if (tracePaused.load(std::memory_order_relaxed)) {
+    return;
+  }
+  uint32_t index = traceHead.fetch_add(1, std::memory_order_relaxed);
+  TraceEvent& event = traceEvents[index & (TRACE_EVENTS - 1)];
+  event.cycles = cycles;
+  event.id = id;
+  event.type = type;
+  event.core = currentCore();
+}
+
+void traceRequestDump() {
+  dumpRequested.store(true);
+}
+
+void traceService() {
+  if (dumpRequested.exchange(false)) {
+    traceDump();
+  }
+}
+
+void traceDump() {
+  tracePaused.store(true);
+  hal::clock().delay(1);  // Let events being written finish
+
+  uint32_t head = traceHead.load();
+  uint32_t count = head < TRACE_EVENTS ? head : TRACE_EVENTS;
+  hal::log().printf("trace-begin %u %u\n", (unsigned)hal::clock().cyclesPerMicrosecond(), (unsigned)count);
+  for (int stage = 0; stage < STAGE_COUNT; stage++) {
+    hal::log().printf("trace-name %d %s\n", stage, profileStageName((ProfileStage)stage));
+  }
+  for (int mark = TRACE_MARK_BASE; mark < TRACE_MARK_END; mark++) {
+    hal::log().printf("trace-name %d %s\n", mark, markNames[mark - TRACE_MARK_BASE]);
+  }
+  // Oldest first
+  for (uint32_t index = head - count; index != head; index++) {
+    const TraceEvent& event = traceEvents[index & (TRACE_EVENTS - 1)];
+    hal::log().printf("trace %c %u %u %08x\n", event.type, (unsigned)event.id, (unsigned)event.core,
+                      (unsigned)event.cycles);
+  }
+  hal::log().printf("trace-end\n");
+
+  traceHead.store(0);
+  tracePaused.store(false);
+}
+
+#endif
@@ -0,0 +1,151 @@
+// Fixed-point RMS kernel against a double-precision reference.
+//   pio test -e native
+
+#include <math.h>
+#include <stdint.h>
+#include <unity.h>
+
+#include "config.h"
+#include "rms.h"
+
+// Rounding the mean square and then the root costs at most ~0.71 of a
+// shifted-sample unit, worst near zero; anything past this is a real error
+#define RMS_TOLERANCE 0.75
+
+#define BLOCK_LEN BUFFER_LEN
+
+void setUp() {}
+void tearDown() {}
+
+// What the old float loops computed, in double
+static double rmsReference(const int32_t* samples, int count, uint32_t spikeLimit, int* validSamples) {
+  double sum = 0;
+  *validSamples = 0;
+  for (int i = 0; i < count; i++) {
+    int64_t sample = samples[i] >> SAMPLE_SHIFT;
+    if ((uint64_t)llabs(sample) < spikeLimit) {
+      sum += (double)sample * (double)sample;
+      (*validSamples)++;
+    }
+  }
+  return *validSamples > 0 ? sqrt(sum / *validSamples) : 0;
+}
+
+static void assertMatchesReference(const int32_t* samples, int count, uint32_t spikeLimit) {
+  int validSamples;
+  double reference = rmsReference(samples, count, spikeLimit, &validSamples);
+  BlockRms result = rmsQ31(samples, count, SAMPLE_SHIFT, spikeLimit);
+  TEST_ASSERT_EQUAL_UINT16(validSamples, result.validSamples);
+  TEST_ASSERT_DOUBLE_WITHIN(RMS_TOLERANCE, reference, (double)result.rms);
+}
+
+// Left-justified I2S word for a shifted sample value
+static int32_t word(int32_t sample) {
+  return (int32_t)((uint32_t)sample << SAMPLE_SHIFT);
+}
+
+static void test_silence() {
+  int32_t block[BLOCK_LEN] = {0};
+  BlockRms result = rmsQ31(block, BLOCK_LEN, SAMPLE_SHIFT, SPIKE_LIMIT);
+  TEST_ASSERT_EQUAL_UINT32(0, result.rms);
+  TEST_ASSERT_EQUAL_UINT16(BLOCK_LEN, result.validSamples);
+}
+
+static void test_full_scale() {
+  // Alternating 18-bit extremes, with the spike filter off
+  int32_t block[BLOCK_LEN];
+  for (int i = 0; i < BLOCK_LEN; i++) {
+    block[i] = (i & 1) ? INT32_MAX : INT32_MIN;
+  }
+  assertMatchesReference(block, BLOCK_LEN, UINT32_MAX);
+
+  // With the pipeline's limit every sample is a spike
+  BlockRms result = rmsQ31(block, BLOCK_LEN, SAMPLE_SHIFT, SPIKE_LIMIT);
+  TEST_ASSERT_EQUAL_UINT16(0, result.validSamples);
+  TEST_ASSERT_EQUAL_UINT32(0, result.rms);
+}
+
+static void test_near_spike_limit() {
+  // Just under the limit counts, at the limit is skipped
+  int32_t block[BLOCK_LEN];
+  for (int i = 0; i < BLOCK_LEN; i++) {
+    int32_t magnitude = (i % 4 == 0) ? SPIKE_LIMIT : SPIKE_LIMIT - 1;
+    block[i] = word((i & 1) ? magnitude : -magnitude);
+  }
+  BlockRms result = rmsQ31(block, BLOCK_LEN, SAMPLE_SHIFT, SPIKE_LIMIT);
+  TEST_ASSERT_EQUAL_UINT16(BLOCK_LEN * 3 / 4, result.validSamples);
+  TEST_ASSERT_EQUAL_UINT32(SPIKE_LIMIT - 1, result.rms);
+  assertMatchesReference(block, BLOCK_LEN, SPIKE_LIMIT);
+}
+
+static void test_random_blocks() {
+  uint32_t state = 12345;
+  int32_t block[BLOCK_LEN];
+  for (int run = 0; run < 2000; run++) {
+    // Amplitudes from zero up to 18-bit full scale, past the spike limit
+    uint32_t amplitude = (1u << (run % 18)) - 1;
+    for (int i = 0; i < BLOCK_LEN; i++) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      int32_t sample = (int32_t)(state % (2 * amplitude + 1)) - (int32_t)amplitude;
+      block[i] = word(sample) | (int32_t)(state >> 24 & ((1 << SAMPLE_SHIFT) - 1));  // Junk in the low bits
+    }
+    assertMatchesReference(block, BLOCK_LEN, SPIKE_LIMIT);
+  }
+}
+
+static void test_recorded_block() {
+  // Left channel of the first 64 frames of a recorded guitar pluck
+  // (CPython's Lib/test/audiodata/pluck-pcm24.wav), left-justified the way
+  // the native WAV source delivers it. The attack clips, so the spike filter
+  // drops 9 samples, and most of the rest square past INT32_MAX
+  static const int32_t block[BLOCK_LEN] = {
+    (int32_t)0x022D6500, (int32_t)0x4B5A0F00, (int32_t)0x3113C300, (int32_t)0x80DCD600, (int32_t)0xCBDEC000, (int32_t)0x48A99800, (int32_t)0xBFE82400, (int32_t)0x036BFB00,
+    (int32_t)0xB8575600, (int32_t)0xB4B05500, (int32_t)0x29983000, (int32_t)0x1A5CA700, (int32_t)0xEDFA3E00, (int32_t)0xC625EB00, (int32_t)0x0E05A900, (int32_t)0xEF292900,
+    (int32_t)0x5758D800, (int32_t)0xFB355700, (int32_t)0x1377BF00, (int32_t)0xD82C5B00, (int32_t)0x978F1600, (int32_t)0xF5F86500, (int32_t)0x08663500, (int32_t)0xDF30FC00,
+    (int32_t)0x117FE000, (int32_t)0x3EE6B800, (int32_t)0xBC77A300, (int32_t)0x66D6DA00, (int32_t)0xCF13B900, (int32_t)0x431D6900, (int32_t)0xC1BB6000, (int32_t)0x5120B900,
+    (int32_t)0xEEDF6400, (int32_t)0x82070000, (int32_t)0x7FFFFF00, (int32_t)0x80000000, (int32_t)0x499C1B00, (int32_t)0x52B73E00, (int32_t)0xEFB2B200, (int32_t)0xCE3CDB00,
+    (int32_t)0xE4B49C00, (int32_t)0x6344A800, (int32_t)0x08C8FE00, (int32_t)0x2BB98600, (int32_t)0x51486F00, (int32_t)0x8BCC6400, (int32_t)0xB6F4EC00, (int32_t)0x44131700,
+    (int32_t)0xD688A400, (int32_t)0xEDB67900, (int32_t)0xD846CE00, (int32_t)0x9ED70700, (int32_t)0x24C7ED00, (int32_t)0x1B6E5C00, (int32_t)0xFA53EF00, (int32_t)0xC2FBAB00,
+    (int32_t)0x08324F00, (int32_t)0xF1DD3900, (int32_t)0x445EDC00, (int32_t)0x15492500, (int32_t)0xFE155D00, (int32_t)0xF8486A00, (int32_t)0x889C4C00, (int32_t)0xEE9C6C00,
+  };
+  assertMatchesReference(block, BLOCK_LEN, SPIKE_LIMIT);
+
+  // Pinned so a kernel change that stays within tolerance still shows up
+  BlockRms result = rmsQ31(block, BLOCK_LEN, SAMPLE_SHIFT, SPIKE_LIMIT);
+  TEST_ASSERT_EQUAL_UINT16(55, result.validSamples);
+  TEST_ASSERT_EQUAL_UINT32(50532, result.rms);
+}
+
+static void test_isqrt64_edges() {
+  TEST_ASSERT_EQUAL_UINT32(0, isqrt64(0));
+  TEST_ASSERT_EQUAL_UINT32(1, isqrt64(1));
+  TEST_ASSERT_EQUAL_UINT32(1, isqrt64(2));
+  TEST_ASSERT_EQUAL_UINT32(2, isqrt64(3));
+  TEST_ASSERT_EQUAL_UINT32(2, isqrt64(4));
+
+  // Round to nearest around k^2 + k, where the true root is just under k + 0.5
+  const uint64_t roots[] = {3, 1000, 65535, 65536, 3037000499ull, 4294967294ull};
+  for (uint64_t k : roots) {
+    TEST_ASSERT_EQUAL_UINT32(k, isqrt64(k * k));
+    TEST_ASSERT_EQUAL_UINT32(k, isqrt64(k * k + k));
+    TEST_ASSERT_EQUAL_UINT32(k + 1, isqrt64(k * k + k + 1));
+    TEST_ASSERT_EQUAL_UINT32(k - 1, isqrt64(k * k - k));
+  }
+
+  // Roots that would round up to 2^32 saturate
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, isqrt64(0xFFFFFFFFull * 0xFFFFFFFFull));
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, isqrt64(UINT64_MAX));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_silence);
+  RUN_TEST(test_full_scale);
+  RUN_TEST(test_near_spike_limit);
+  RUN_TEST(test_random_blocks);
+  RUN_TEST(test_recorded_block);
+  RUN_TEST(test_isqrt64_edges);
+  return UNITY_END();
+}
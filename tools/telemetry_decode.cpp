@@ -0,0 +1,110 @@
+// Decodes the binary telemetry stream (see include/telemetry.h) back into
+// CSV or Serial plotter lines. Log text mixed into the stream goes to
+// stderr untouched.
+//
+//   g++ -std=gnu++17 -O2 -Iinclude tools/telemetry_decode.cpp src/telemetry.cpp -o telemetry_decode
+//   stty -f /dev/cu.usbserial-10 115200 raw   # Linux: stty -F ... 115200 raw
+//   ./telemetry_decode [--plotter] < /dev/cu.usbserial-10
+//   .pio/build/native/program -t telemetry.bin input.wav && ./telemetry_decode telemetry.bin
+
+#include <stdio.h>
+#include <string.h>
+
+#include "telemetry.h"
+
+#define CHUNK_MAX 256  // Longer runs without a zero can only be text
+
+static bool plotter = false;
+static bool haveSequence = false;
+static uint16_t nextSequence = 0;
+static unsigned long frames = 0;
+static unsigned long lost = 0;
+static unsigned long badChunks = 0;
+
+static void emit(const TelemetrySample& sample) {
+  if (haveSequence && sample.sequence != nextSequence) {
+    lost += (uint16_t)(sample.sequence - nextSequence);
+  }
+  haveSequence = true;
+  nextSequence = sample.sequence + 1;
+  frames++;
+
+  if (plotter) {
+    printf("MinRange:%d,Volume:%.2f,SmoothVolume:%.2f,SmoothPeak:%.2f,MaxRange:%d\n", -1000, sample.volume,
+           sample.smoothVolume, sample.smoothPeak, 4000);
+  } else {
+    printf("%u,%u,%.1f,%.1f,%.1f\n", (unsigned)sample.sequence, (unsigned)sample.timeMs, sample.volume,
+           sample.smoothVolume, sample.smoothPeak);
+  }
+}
+
+// Everything between two zeros is either one frame or log text
+static void handleChunk(const uint8_t* chunk, size_t length, bool truncated) {
+  if (length == 0) {
+    return;
+  }
+  TelemetrySample sample;
+  if (!truncated && telemetryDecode(chunk, length, sample)) {
+    emit(sample);
+    return;
+  }
+  // A frame-sized chunk that failed its CRC is a corrupted frame, not text
+  if (length == TELEMETRY_PAYLOAD_SIZE + 1 && memchr(chunk, '\n', length) == NULL) {
+    badChunks++;
+    return;
+  }
+  fwrite(chunk, 1, length, stderr);
+}
+
+int main(int argc, char** argv) {
+  const char* path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--plotter") == 0) {
+      plotter = true;
+    } else if (path == NULL && argv[i][0] != '-') {
+      path = argv[i];
+    } else {
+      fprintf(stderr, "usage: %s [--plotter] [capture.bin]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  FILE* input = path != NULL ? fopen(path, "rb") : stdin;
+  if (input == NULL) {
+    fprintf(stderr, "cannot read %s\n", path);
+    return 1;
+  }
+  // Line buffered so a live port shows up as it arrives
+  setvbuf(stdout, NULL, _IOLBF, 0);
+
+  if (!plotter) {
+    printf("sequence,time_ms,volume,smooth_volume,smooth_peak\n");
+  }
+
+  uint8_t chunk[CHUNK_MAX];
+  size_t length = 0;
+  bool truncated = false;
+  int c;
+  while ((c = fgetc(input)) != EOF) {
+    if (c == 0) {
+      handleChunk(chunk, length, truncated);
+      length = 0;
+      truncated = false;
+    } else if (length < sizeof(chunk)) {
+      chunk[length++] = c;
+    } else {
+      // Pass long text on instead of holding it
+      handleChunk(chunk, length, true);
+      chunk[0] = c;
+      length = 1;
+      truncated = true;
+    }
+  }
+  handleChunk(chunk, length, truncated);
+
+  fprintf(stderr, "%lu frames, %lu lost, %lu corrupted\n", frames, lost, badChunks);
+  if (input != stdin) {
+    fclose(input);
+  }
+  return 0;
+}
@@ -0,0 +1,165 @@
+// Converts a trace dump (see include/trace.h) into Chrome trace event JSON
+// for chrome://tracing or ui.perfetto.dev. Other lines in the capture, such
+// as log output, are ignored; with several dumps the last one is used.
+//
+//   g++ -std=gnu++17 -O2 tools/trace_to_chrome.cpp -o trace_to_chrome
+//   ./trace_to_chrome serial_capture.txt > trace.json
+//
+// Timestamps are 32-bit cycle counts that wrap (every ~18 s at 240 MHz).
+// Each core's events are in recording order in the dump, but the two cores
+// interleave with small inversions, so each core is unwrapped against its
+// own previous event; a core's first event is placed against the event
+// before it. Each core shows as one thread, so tasks that share a core
+// (capture and logging on core 0) share its row.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+struct Event {
+  char type;
+  unsigned id;
+  unsigned core;
+  uint64_t cycles;  // Unwrapped
+};
+
+// Last timestamp seen on one core
+struct CoreClock {
+  uint32_t raw;
+  uint64_t cycles;  // Unwrapped
+};
+
+struct Dump {
+  double cyclesPerMicro = 1;
+  std::map<unsigned, std::string> names;
+  std::vector<Event> events;
+};
+
+static void writeName(FILE* out, const std::string& name) {
+  fputc('"', out);
+  for (char c : name) {
+    if (c == '"' || c == '\\') {
+      fputc('\\', out);
+    }
+    fputc(c, out);
+  }
+  fputc('"', out);
+}
+
+int main(int argc, char** argv) {
+  if (argc > 2) {
+    fprintf(stderr, "usage: %s [capture.txt] > trace.json\n", argv[0]);
+    return 1;
+  }
+  FILE* input = argc == 2 ? fopen(argv[1], "r") : stdin;
+  if (input == NULL) {
+    fprintf(stderr, "cannot read %s\n", argv[1]);
+    return 1;
+  }
+
+  Dump dump;
+  Dump current;
+  bool inDump = false;
+  bool complete = false;
+  uint32_t lastRaw = 0;
+  std::map<unsigned, CoreClock> clocks;
+  char line[512];
+  while (fgets(line, sizeof(line), input) != NULL) {
+    unsigned cyclesPerMicro;
+    unsigned count;
+    unsigned id;
+    unsigned core;
+    unsigned raw;
+    char type;
+    char name[256];
+    if (sscanf(line, "trace-begin %u %u", &cyclesPerMicro, &count) == 2) {
+      current = Dump();
+      current.cyclesPerMicro = cyclesPerMicro > 0 ? cyclesPerMicro : 1;
+      current.events.reserve(count);
+      clocks.clear();
+      inDump = true;
+    } else if (!inDump) {
+      continue;
+    } else if (sscanf(line, "trace-name %u %255[^\n]", &id, name) == 2) {
+      current.names[id] = name;
+    } else if (sscanf(line, "trace %c %u %u %x", &type, &id, &core, &raw) == 4) {
+      // Signed difference to the previous event, so a wrap carries over.
+      // Start a wrap up so an early inversion doesn't go below zero.
+      uint64_t cycles = (uint64_t)raw + (1ull << 32);
+      auto clock = clocks.find(core);
+      if (clock != clocks.end()) {
+        cycles = clock->second.cycles + (int64_t)(int32_t)(raw - clock->second.raw);
+      } else if (!current.events.empty()) {
+        cycles = current.events.back().cycles + (int64_t)(int32_t)(raw - lastRaw);
+      }
+      clocks[core] = {raw, cycles};
+      lastRaw = raw;
+      current.events.push_back({type, id, core, cycles});
+    } else if (strncmp(line, "trace-end", 9) == 0) {
+      dump = current;
+      inDump = false;
+      complete = true;
+    }
+  }
+  if (input != stdin) {
+    fclose(input);
+  }
+  if (!complete) {
+    fprintf(stderr, "no complete trace dump found\n");
+    return 1;
+  }
+
+  // Times relative to the first event
+  uint64_t origin = UINT64_MAX;
+  uint64_t last = 0;
+  for (const Event& event : dump.events) {
+    origin = event.cycles < origin ? event.cycles : origin;
+    last = event.cycles > last ? event.cycles : last;
+  }
+
+  printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  bool first = true;
+  std::map<unsigned, bool> cores;
+  std::map<std::pair<unsigned, unsigned>, int> open;  // Begins without their end, per core and id
+  unsigned skipped = 0;
+  for (const Event& event : dump.events) {
+    // The oldest events may have lost their begin to the ring wrapping
+    std::pair<unsigned, unsigned> key(event.core, event.id);
+    if (event.type == 'B') {
+      open[key]++;
+    } else if (event.type == 'E') {
+      if (open[key] == 0) {
+        skipped++;
+        continue;
+      }
+      open[key]--;
+    }
+    cores[event.core] = true;
+
+    auto found = dump.names.find(event.id);
+    std::string name = found != dump.names.end() ? found->second : "event " + std::to_string(event.id);
+    printf("%s{\"name\":", first ? "" : ",\n");
+    writeName(stdout, name);
+    printf(",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u%s}", event.type == 'I' ? 'i' : event.type,
+           (event.cycles - origin) / dump.cyclesPerMicro, event.core, event.type == 'I' ? ",\"s\":\"t\"" : "");
+    first = false;
+  }
+  for (const auto& core : cores) {
+    printf("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"core %u\"}}",
+           first ? "" : ",\n", core.first, core.first);
+    first = false;
+  }
+  printf("\n]}\n");
+
+  fprintf(stderr, "%zu events over %.1f ms", dump.events.size(),
+          dump.events.empty() ? 0.0 : (last - origin) / dump.cyclesPerMicro / 1000);
+  if (skipped > 0) {
+    fprintf(stderr, ", %u ends without a begin dropped", skipped);
+  }
+  fprintf(stderr, "\n");
+  return 0;
+}